@@ -0,0 +1,355 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "archive.h"
+
+#ifdef HAVE_LIBCRYPTO
+#include <openssl/evp.h>
+#endif
+
+namespace SvnDump {
+
+namespace {
+  const char ARCHIVE_MAGIC[8] = { 'S', 'V', 'N', 'D', 'G', 'S', '0', '1' };
+
+  inline bool valid_index(uint32_t i, uint64_t count) {
+    return i == Archive::NONE || i < count;
+  }
+}
+
+Archive::Archive(const filesystem::path& file)
+  : mapping(nullptr), mapping_len(0)
+{
+  int fd = ::open(file.string().c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::logic_error(std::string("Could not open dump archive: ") +
+                           file.string());
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::logic_error(std::string("Could not stat dump archive: ") +
+                           file.string());
+  }
+  mapping_len = static_cast<std::size_t>(st.st_size);
+
+  if (mapping_len < sizeof(Header)) {
+    ::close(fd);
+    throw std::logic_error(std::string("Corrupt dump archive: ") +
+                           file.string());
+  }
+
+  void * addr = ::mmap(nullptr, mapping_len, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);          // the mapping keeps its own reference
+  if (addr == MAP_FAILED)
+    throw std::logic_error(std::string("Could not map dump archive: ") +
+                           file.string());
+  mapping = static_cast<const char *>(addr);
+  header  = reinterpret_cast<const Header *>(mapping);
+
+  // Every table must lie within the file, and every index and extent
+  // within its table, so that a damaged archive is refused here rather
+  // than read out of bounds later.
+  auto section = [&](uint64_t offset, uint64_t count, std::size_t size) {
+    return offset % 8 == 0 && offset <= mapping_len &&
+      count <= (mapping_len - offset) / size;
+  };
+  auto extents = [&](const Extent * table, uint64_t count) {
+    for (uint64_t i = 0; i < count; ++i)
+      if (table[i].offset > mapping_len ||
+          table[i].length > mapping_len - table[i].offset)
+        return false;
+    return true;
+  };
+
+  bool valid =
+    std::memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0 &&
+    section(header->strings_offset, header->string_count, sizeof(Extent)) &&
+    section(header->revisions_offset, header->revision_count,
+            sizeof(Revision)) &&
+    section(header->nodes_offset, header->node_count, sizeof(Node)) &&
+    section(header->texts_offset, header->text_count, sizeof(Extent));
+
+  if (valid) {
+    strings   = reinterpret_cast<const Extent *>
+      (mapping + header->strings_offset);
+    revisions = reinterpret_cast<const Revision *>
+      (mapping + header->revisions_offset);
+    nodes     = reinterpret_cast<const Node *>
+      (mapping + header->nodes_offset);
+    texts     = reinterpret_cast<const Extent *>
+      (mapping + header->texts_offset);
+
+    valid = (extents(strings, header->string_count) &&
+             extents(texts, header->text_count));
+
+    for (uint64_t i = 0; valid && i < header->revision_count; ++i) {
+      const Revision& rev(revisions[i]);
+      valid = (rev.author < header->string_count &&
+               valid_index(rev.log, header->string_count) &&
+               rev.first_node <= header->node_count &&
+               rev.nodes <= header->node_count - rev.first_node &&
+               (i == 0 || rev.rev > revisions[i - 1].rev));
+    }
+    for (uint64_t i = 0; valid && i < header->node_count; ++i) {
+      const Node& node(nodes[i]);
+      valid = (node.path < header->string_count &&
+               valid_index(node.copy_from_path, header->string_count) &&
+               valid_index(node.text, header->text_count) &&
+               valid_index(node.props, header->text_count) &&
+               valid_index(node.md5, header->string_count) &&
+               valid_index(node.sha1, header->string_count) &&
+               valid_index(node.delta_base_md5, header->string_count));
+    }
+  }
+
+  if (! valid) {
+    ::munmap(const_cast<char *>(mapping), mapping_len);
+    throw std::logic_error(std::string("Corrupt dump archive: ") +
+                           file.string());
+  }
+}
+
+Archive::~Archive()
+{
+  ::munmap(const_cast<char *>(mapping), mapping_len);
+}
+
+bool Archive::detect(const filesystem::path& file)
+{
+  filesystem::ifstream in(file, std::ios::in | std::ios::binary);
+
+  char magic[sizeof(ARCHIVE_MAGIC)];
+  in.read(magic, sizeof(magic));
+  return in.gcount() == sizeof(magic) &&
+    std::memcmp(magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) == 0;
+}
+
+std::size_t Archive::find(int rev) const
+{
+  return static_cast<std::size_t>
+    (std::lower_bound(revisions, revisions + header->revision_count, rev,
+                      [](const Revision& entry, int value) {
+                        return entry.rev < value;
+                      }) - revisions);
+}
+
+/**
+ * The archive is written to a temporary file beside it, which replaces
+ * it only once it is complete.  Its header is written last, when the
+ * offsets of the tables are known.
+ */
+ArchiveWriter::ArchiveWriter(const filesystem::path& file)
+  : pathname(file), tmp_pathname(file.string() + ".tmp"), offset(0),
+    stored_bytes(0), duplicate_bytes(0)
+{
+  out.open(tmp_pathname, std::ios::out | std::ios::binary);
+  if (! out.good())
+    throw std::logic_error(std::string("Could not create dump archive: ") +
+                           tmp_pathname.string());
+
+  Archive::Header header;
+  std::memset(&header, 0, sizeof(header));
+  write(&header, sizeof(header));
+}
+
+void ArchiveWriter::write(const void * data, std::size_t len)
+{
+  out.write(static_cast<const char *>(data),
+            static_cast<std::streamsize>(len));
+  offset += len;
+}
+
+void ArchiveWriter::pad()
+{
+  static const char zeroes[8] = { 0 };
+  if (offset % 8 != 0)
+    write(zeroes, 8 - offset % 8);
+}
+
+uint32_t ArchiveWriter::add_string(const char * data, std::size_t len)
+{
+  Archive::Extent extent = { string_data.size(), len };
+  string_data.append(data, len);
+  strings.push_back(extent);
+  return static_cast<uint32_t>(strings.size() - 1);
+}
+
+uint32_t ArchiveWriter::intern(const std::string& str)
+{
+  std::unordered_map<std::string, uint32_t>::const_iterator i =
+    string_ids.find(str);
+  if (i != string_ids.end())
+    return (*i).second;
+
+  uint32_t id = add_string(str.data(), str.length());
+  string_ids.insert(std::make_pair(str, id));
+  return id;
+}
+
+/**
+ * Store a text or property block, unless the same bytes have already
+ * been stored.  They are known by their SHA1, as Subversion itself
+ * knows the representations it shares.
+ */
+uint32_t ArchiveWriter::add_text(const char * data, std::size_t len)
+{
+#ifdef HAVE_LIBCRYPTO
+  unsigned char id[EVP_MAX_MD_SIZE];
+  unsigned int  id_len = 0;
+  if (! EVP_Digest(data, len, id, &id_len, EVP_sha1(), nullptr))
+    throw std::logic_error("Could not compute a checksum");
+
+  std::string key(reinterpret_cast<const char *>(id), id_len);
+  std::unordered_map<std::string, uint32_t>::const_iterator i =
+    text_ids.find(key);
+  if (i != text_ids.end()) {
+    duplicate_bytes += len;
+    return (*i).second;
+  }
+#endif
+
+  Archive::Extent extent = { offset, len };
+  write(data, len);
+  stored_bytes += len;
+  texts.push_back(extent);
+
+  uint32_t index = static_cast<uint32_t>(texts.size() - 1);
+#ifdef HAVE_LIBCRYPTO
+  text_ids.insert(std::make_pair(key, index));
+#endif
+  return index;
+}
+
+/**
+ * Record a node read with its text and checksums.  The text is stored
+ * as the dump has it, so that a delta stays a delta.
+ */
+void ArchiveWriter::add(const File::Node& node)
+{
+  if (revisions.empty() || revisions.back().rev != node.curr_rev) {
+    const RevisionInfo& info(node.get_rev_info());
+
+    Archive::Revision record;
+    record.rev        = node.curr_rev;
+    record.author     = intern(info.author);
+    record.log        = info.log ?
+      add_string(info.log->data(), info.log->length()) : Archive::NONE;
+    record.nodes      = 0;
+    record.date       = static_cast<int64_t>(info.date);
+    record.first_node = nodes.size();
+    revisions.push_back(record);
+  }
+  ++revisions.back().nodes;
+
+  Archive::Node record;
+  std::memset(&record, 0, sizeof(record));
+
+  record.path   = intern(node.pathname.string());
+  record.action = static_cast<uint8_t>(node.action);
+  record.kind   = static_cast<uint8_t>(node.kind);
+
+  if (node.copy_from_rev) {
+    record.copy_from_rev  = *node.copy_from_rev;
+    record.copy_from_path = node.copy_from_path ?
+      intern(node.copy_from_path->string()) : Archive::NONE;
+  } else {
+    record.copy_from_rev  = -1;
+    record.copy_from_path = Archive::NONE;
+  }
+
+  record.text  = node.text ?
+    add_text(node.text, node.text_len) : Archive::NONE;
+  record.props = node.props && node.props_len > 0 ?
+    add_text(node.props, node.props_len) : Archive::NONE;
+
+  record.md5   = node.md5_checksum ?
+    intern(*node.md5_checksum) : Archive::NONE;
+  record.sha1  = node.sha1_checksum ?
+    intern(*node.sha1_checksum) : Archive::NONE;
+  record.delta_base_md5 = node.delta_base_md5 ?
+    intern(*node.delta_base_md5) : Archive::NONE;
+
+  if (node.text_delta)
+    record.flags |= Archive::FLAG_TEXT_DELTA;
+  if (node.props_delta)
+    record.flags |= Archive::FLAG_PROPS_DELTA;
+
+  nodes.push_back(record);
+}
+
+void ArchiveWriter::finish(int last_rev)
+{
+  Archive::Header header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+
+  header.last_rev =
+    last_rev != -1 || revisions.empty() ? last_rev : revisions.back().rev;
+  header.string_count   = strings.size();
+  header.revision_count = revisions.size();
+  header.node_count     = nodes.size();
+  header.text_count     = texts.size();
+
+  pad();
+  uint64_t string_base = offset;
+  write(string_data.data(), string_data.size());
+  for (std::vector<Archive::Extent>::iterator i = strings.begin();
+       i != strings.end();
+       ++i)
+    (*i).offset += string_base;
+
+  pad();
+  header.strings_offset = offset;
+  write(strings.data(), strings.size() * sizeof(Archive::Extent));
+  pad();
+  header.revisions_offset = offset;
+  write(revisions.data(), revisions.size() * sizeof(Archive::Revision));
+  pad();
+  header.nodes_offset = offset;
+  write(nodes.data(), nodes.size() * sizeof(Archive::Node));
+  pad();
+  header.texts_offset = offset;
+  write(texts.data(), texts.size() * sizeof(Archive::Extent));
+
+  out.seekp(0, std::ios::beg);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.close();
+  if (out.fail())
+    throw std::logic_error(std::string("Could not write dump archive: ") +
+                           tmp_pathname.string());
+
+  filesystem::rename(tmp_pathname, pathname);
+}
+
+} // namespace SvnDump
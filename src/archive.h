@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _ARCHIVE_H
+#define _ARCHIVE_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * A dump digested by "subconvert digest" into a binary archive, which
+   * File reads through mmap(2) in place of the dump.  The archive holds
+   * a fixed-width record for each revision and node, a table of strings
+   * in which paths and authors are interned, and the texts and property
+   * blocks of the nodes, each distinct one stored only once.
+   *
+   * Its layout is a Header, the texts, the string data, and then the
+   * string, revision, node and text tables, each aligned to 8 bytes.
+   */
+  class Archive : public noncopyable
+  {
+  public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Extent {
+      uint64_t offset;          // in the archive
+      uint64_t length;
+    };
+
+    struct Header {
+      char     magic[8];
+      int32_t  last_rev;
+      uint32_t reserved;
+      uint64_t string_count;
+      uint64_t revision_count;
+      uint64_t node_count;
+      uint64_t text_count;
+      uint64_t strings_offset;
+      uint64_t revisions_offset;
+      uint64_t nodes_offset;
+      uint64_t texts_offset;
+    };
+
+    struct Revision {
+      int32_t  rev;
+      uint32_t author;          // index into the strings
+      uint32_t log;             // NONE if the revision has no log
+      uint32_t nodes;
+      int64_t  date;
+      uint64_t first_node;
+    };
+
+    enum {
+      FLAG_TEXT_DELTA  = 0x01,
+      FLAG_PROPS_DELTA = 0x02
+    };
+
+    struct Node {
+      uint32_t path;
+      uint32_t copy_from_path;  // NONE if not a copy
+      int32_t  copy_from_rev;   // -1 if not a copy
+      uint32_t text;            // index into the texts, or NONE
+      uint32_t props;           // likewise
+      uint32_t md5;             // index into the strings, or NONE
+      uint32_t sha1;
+      uint32_t delta_base_md5;
+      uint8_t  action;
+      uint8_t  kind;
+      uint8_t  flags;
+      uint8_t  reserved;
+    };
+
+  private:
+    const char *   mapping;
+    std::size_t    mapping_len;
+    const Header * header;
+
+    const Extent *   strings;
+    const Revision * revisions;
+    const Node *     nodes;
+    const Extent *   texts;
+
+  public:
+    Archive(const filesystem::path& file);
+    ~Archive();
+
+    static bool detect(const filesystem::path& file);
+
+    int last_rev() const {
+      return header->last_rev;
+    }
+
+    std::size_t revision_count() const {
+      return static_cast<std::size_t>(header->revision_count);
+    }
+    const Revision& get_revision(std::size_t i) const {
+      return revisions[i];
+    }
+    const Node& get_node(uint64_t i) const {
+      return nodes[i];
+    }
+
+    const char * get_string(uint32_t i, std::size_t& len) const {
+      len = static_cast<std::size_t>(strings[i].length);
+      return mapping + strings[i].offset;
+    }
+    std::string get_string(uint32_t i) const {
+      std::size_t  len;
+      const char * data = get_string(i, len);
+      return std::string(data, len);
+    }
+    const char * get_text(uint32_t i, std::size_t& len) const {
+      len = static_cast<std::size_t>(texts[i].length);
+      return mapping + texts[i].offset;
+    }
+
+    // The index of the first revision numbered `rev' or higher
+    std::size_t find(int rev) const;
+  };
+
+  /**
+   * Writes an Archive from the nodes of a dump, read with their texts
+   * and checksums.  Texts and property blocks are told apart by their
+   * SHA1, where libcrypto is available; otherwise each is stored as it
+   * comes.
+   */
+  class ArchiveWriter : public noncopyable
+  {
+    filesystem::path     pathname;
+    filesystem::path     tmp_pathname;
+    filesystem::ofstream out;
+    uint64_t             offset;
+
+    std::string                  string_data;
+    std::vector<Archive::Extent> strings;
+    std::vector<Archive::Revision> revisions;
+    std::vector<Archive::Node>   nodes;
+    std::vector<Archive::Extent> texts;
+
+    std::unordered_map<std::string, uint32_t> string_ids;
+    std::unordered_map<std::string, uint32_t> text_ids;
+
+    std::size_t stored_bytes;
+    std::size_t duplicate_bytes;
+
+    uint32_t add_string(const char * data, std::size_t len);
+    uint32_t intern(const std::string& str);
+    uint32_t add_text(const char * data, std::size_t len);
+    void     write(const void * data, std::size_t len);
+    void     pad();
+
+  public:
+    ArchiveWriter(const filesystem::path& file);
+
+    void add(const File::Node& node);
+    void finish(int last_rev);
+
+    std::size_t get_revision_count() const {
+      return revisions.size();
+    }
+    std::size_t get_node_count() const {
+      return nodes.size();
+    }
+    std::size_t get_text_count() const {
+      return texts.size();
+    }
+    std::size_t get_stored_bytes() const {
+      return stored_bytes;
+    }
+    std::size_t get_duplicate_bytes() const {
+      return duplicate_bytes;
+    }
+  };
+}
+
+#endif // _ARCHIVE_H
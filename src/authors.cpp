@@ -120,6 +120,22 @@ void Authors::operator()(const SvnDump::File& dump, const SvnDump::File::Node&)
   }
 }
 
+/**
+ * Fold in the authors found by scanning a later part of the dump.
+ */
+void Authors::merge(const Authors& other)
+{
+  for (authors_map::const_iterator i = other.authors.begin();
+       i != other.authors.end();
+       ++i) {
+    authors_map::iterator j = authors.find((*i).first);
+    if (j != authors.end())
+      (*j).second.count += (*i).second.count;
+    else
+      authors.insert(*i);
+  }
+}
+
 void Authors::finish()
 {
   status->finish();
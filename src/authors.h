@@ -51,6 +51,9 @@ struct Authors
   typedef std::map<std::string, AuthorInfo> authors_map;
   typedef authors_map::value_type           authors_value;
 
+  // Only the author of each revision is read from the dump
+  static const unsigned fields = SvnDump::File::FIELD_AUTHOR;
+
   authors_map     authors;
   StatusDisplay * status;
   int             last_rev;
@@ -61,6 +64,7 @@ struct Authors
   int load_authors(const filesystem::path& pathname);
 
   void operator()(const SvnDump::File& dump, const SvnDump::File::Node&);
+  void merge(const Authors& other);
   void finish();
 };
 
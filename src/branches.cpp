@@ -154,10 +154,31 @@ void Branches::operator()(const SvnDump::File&       dump,
 
   if (node.get_action() != SvnDump::File::Node::ACTION_DELETE &&
       (node.get_kind()  == SvnDump::File::Node::KIND_FILE ||
-       node.has_copy_from()))
-    apply_action(rev, dump.get_rev_date(),
-                 node.get_kind() == SvnDump::File::Node::KIND_DIR ?
-                 node.get_path() : node.get_path().parent_path());
+       node.has_copy_from())) {
+    filesystem::path pathname(node.get_kind() ==
+                              SvnDump::File::Node::KIND_DIR ?
+                              node.get_path() : node.get_path().parent_path());
+    if (! deferred) {
+      apply_action(rev, dump.get_rev_date(), pathname);
+    }
+    else if (actions.empty() || actions.back().rev != rev ||
+             actions.back().pathname != pathname) {
+      // Repeating an action within one revision changes nothing
+      Action action = { rev, dump.get_rev_date(), pathname };
+      actions.push_back(action);
+    }
+  }
+}
+
+/**
+ * Apply the actions recorded while scanning a later part of the dump.
+ */
+void Branches::merge(const Branches& other)
+{
+  for (actions_list::const_iterator i = other.actions.begin();
+       i != other.actions.end();
+       ++i)
+    apply_action((*i).rev, (*i).date, (*i).pathname);
 }
 
 void Branches::finish()
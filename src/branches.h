@@ -52,11 +52,30 @@ struct Branches
   typedef std::map<filesystem::path, BranchInfo> branches_map;
   typedef branches_map::value_type branches_value;
 
+  struct Action {
+    int              rev;
+    std::time_t      date;
+    filesystem::path pathname;
+  };
+
+  typedef std::vector<Action> actions_list;
+
+  // What is read from the dump for each node
+  static const unsigned fields = (SvnDump::File::FIELD_DATE |
+                                  SvnDump::File::FIELD_PATH |
+                                  SvnDump::File::FIELD_NODE);
+
   branches_map   branches;      // only used for the "branches" command
   StatusDisplay& status;
   int            last_rev;
 
-  Branches(StatusDisplay& _status) : status(_status), last_rev(-1) {}
+  // When scanning part of a dump, actions are only recorded, since
+  // they must be applied in revision order.
+  bool           deferred;
+  actions_list   actions;
+
+  Branches(StatusDisplay& _status)
+    : status(_status), last_rev(-1), deferred(false) {}
 
   static int load_branches(const filesystem::path& pathname,
                            ConvertRepository& converter,
@@ -66,6 +85,7 @@ struct Branches
                     const filesystem::path& pathname);
   void operator()(const SvnDump::File&       dump,
                   const SvnDump::File::Node& node);
+  void merge(const Branches& other);
   void finish();
 };
 
@@ -43,7 +43,9 @@ void ConvertRepository::free_past_trees()
   // will never receive another commit.
 
   // We no longer need copy-from target revisions if we're passed it,
-  // _and_ we're passed the revision that needed it.
+  // _and_ we're passed the revision that needed it.  Without a pre-scan
+  // (--skip, or a dump read from a pipe) the list is empty, and every
+  // past tree is kept.
   int popped = -1;
   while (! copy_from.empty() &&
          last_rev > copy_from.front().second &&
@@ -113,6 +115,60 @@ Git::TreePtr ConvertRepository::get_past_tree()
   return nullptr;
 }
 
+/**
+ * Find the text a node's delta applies to, when it has dropped out of
+ * the dump's cache: the copy source for a copy, or otherwise what the
+ * path last held.  Both are read back from the flat history.
+ */
+bool ConvertRepository::read_base_text(const SvnDump::File::Node& base_node,
+                                       std::string&               text)
+{
+  Git::ObjectPtr obj;
+  if (base_node.has_copy_from()) {
+    if (Git::TreePtr past_tree = get_past_tree())
+      obj = past_tree->lookup(base_node.get_copy_from_path());
+  } else {
+    obj = current_object(base_node.get_path());
+  }
+  return obj && repository->read_blob(obj, text);
+}
+
+/**
+ * Look up what a Subversion pathname currently holds in the flat
+ * history, before the current node is applied.
+ */
+Git::ObjectPtr
+ConvertRepository::current_object(const filesystem::path& pathname)
+{
+  Git::CommitPtr commit(history_branch->next_commit ?
+                        history_branch->next_commit :
+                        history_branch->commit);
+  return commit ? commit->lookup(pathname) : nullptr;
+}
+
+/**
+ * Work out the mode of a file from the svn:special and svn:executable
+ * properties of the current node, given the mode it had before.  Only
+ * nodes with a property block can change it.
+ */
+unsigned int ConvertRepository::file_attributes(unsigned int previous)
+{
+  if (! node->has_props())
+    return previous;
+
+  bool delta = node->is_props_delta();
+
+  bool special =
+    node->has_property("svn:special") ||
+    (delta && previous == 0120000 && ! node->deletes_property("svn:special"));
+  bool executable =
+    node->has_property("svn:executable") ||
+    (delta && previous == 0100755 &&
+     ! node->deletes_property("svn:executable"));
+
+  return special ? 0120000 : (executable ? 0100755 : 0100644);
+}
+
 void ConvertRepository::establish_commit_info()
 {
   // Setup the author and commit comment
@@ -320,6 +376,13 @@ bool ConvertRepository::add_file(Git::Repository * repo,
     obj = obj->copy_to_name(pathname.filename().string(),
                             related_branch != nullptr);
 
+    // Properties given with the copy may change the file's mode
+    unsigned int attributes = file_attributes(obj->attributes);
+    if (attributes != obj->attributes) {
+      obj = obj->copy_to_name(obj->name, true);
+      obj->attributes = attributes;
+    }
+
     update_object(repo, pathname, obj,
                   find_branch(repo, from_path, related_branch),
                   related_branch, debug_text);
@@ -327,13 +390,43 @@ bool ConvertRepository::add_file(Git::Repository * repo,
   }
   else if (! (node->get_action() == SvnDump::File::Node::ACTION_CHANGE &&
               ! node->has_text())) {
-    obj = repo->create_blob(pathname.filename().string(),
-                            node->has_text() ? node->get_text() : "",
-                            node->has_text() ? node->get_text_length() : 0);
+    unsigned int previous = 0100644;
+    if (node->get_action() == SvnDump::File::Node::ACTION_CHANGE)
+      if (Git::ObjectPtr current = current_object(node->get_path()))
+        previous = current->attributes;
+
+    unsigned int attributes = file_attributes(previous);
+    const char * text       = node->has_text() ? node->get_text() : "";
+    std::size_t  text_len   = node->has_text() ? node->get_text_length() : 0;
+
+    // Subversion keeps a symbolic link as the text "link TARGET"
+    if (attributes == 0120000 && text_len >= 5 &&
+        std::strncmp(text, "link ", 5) == 0) {
+      text     += 5;
+      text_len -= 5;
+    }
+
+    obj = repo->create_blob(pathname.filename().string(), text, text_len,
+                            attributes);
 
     update_object(repo, pathname, obj, nullptr, related_branch, debug_text);
     return true;
   }
+  else if (node->has_props()) {
+    // Only the properties changed, which matters if the mode did
+    obj = current_object(node->get_path());
+    if (obj && obj->is_blob()) {
+      unsigned int attributes = file_attributes(obj->attributes);
+      if (attributes != obj->attributes) {
+        obj = obj->copy_to_name(pathname.filename().string(), true);
+        obj->attributes = attributes;
+
+        update_object(repo, pathname, obj, nullptr, related_branch,
+                      debug_text);
+        return true;
+      }
+    }
+  }
   return false;
 }
 
@@ -380,35 +473,62 @@ int ConvertRepository::prescan(SvnDump::File::Node& _node)
 {
   node = &_node;
 
-  int errors = 0;
-
   status.update(node->get_rev_nr());
 
+  PrescanResult result;
+  prescan(*node, result);
+  return merge_prescan(result);
+}
+
+/**
+ * Check a node against the authors and branches given by the user, and
+ * note which past revision it copies from.  Nothing is changed or
+ * logged here, so that several parts of a dump may be pre-scanned at
+ * once; merge_prescan() reports the results.
+ */
+void ConvertRepository::prescan(const SvnDump::File::Node& node,
+                                PrescanResult&             result) const
+{
+  prescan(node.get_rev_nr(), node.get_rev_author(), node.get_action(),
+          node.get_kind(), node.get_path(),
+          node.has_copy_from() ? node.get_copy_from_rev() : -1,
+          node.has_copy_from() ? node.get_copy_from_path() :
+          filesystem::path(), result);
+}
+
+/**
+ * The same check, given only the node's headers, as kept by a
+ * PrescanCache.  A `copy_from_rev' of -1 means the node is not a copy.
+ */
+void ConvertRepository::prescan(int                         rev,
+                                const std::string&          author_id,
+                                SvnDump::File::Node::Action action,
+                                SvnDump::File::Node::Kind   kind,
+                                const filesystem::path&     pathname,
+                                int                         copy_from_rev,
+                                const filesystem::path&     copy_from_path,
+                                PrescanResult&              result) const
+{
   if (! authors.authors.empty()) {
-    std::string author_id(node->get_rev_author());
-    Authors::authors_map::iterator author =
-      authors.authors.find(author_id);
-    if (author == authors.authors.end()) {
+    if (authors.authors.find(author_id) == authors.authors.end()) {
       std::ostringstream buf;
       buf << "Unrecognized author id: " << author_id;
-      status.warn(buf.str());
-      ++errors;
+      result.report(rev, PrescanResult::WARN, buf.str());
+      ++result.errors;
     }
   }
 
-  if (node->has_copy_from()) {
+  if (copy_from_rev != -1) {
     if (status.debug_mode()) {
       std::ostringstream buf;
-      buf << "Copy from: " << node->get_rev_nr()
-          << " <- " << node->get_copy_from_rev();
-      status.debug(buf.str());
+      buf << "Copy from: " << rev << " <- " << copy_from_rev;
+      result.report(rev, PrescanResult::DEBUG, buf.str());
     }
 
-    if (copy_from.empty() ||
-        ! (copy_from.back().first == node->get_rev_nr() &&
-           copy_from.back().second == node->get_copy_from_rev())) {
-      copy_from.push_back(copy_from_value(node->get_rev_nr(),
-                                          node->get_copy_from_rev()));
+    if (result.copy_from.empty() ||
+        ! (result.copy_from.back().first == rev &&
+           result.copy_from.back().second == copy_from_rev)) {
+      result.copy_from.push_back(copy_from_value(rev, copy_from_rev));
     }
   }
 
@@ -416,29 +536,66 @@ int ConvertRepository::prescan(SvnDump::File::Node& _node)
     // Ignore pathname which only add or modify directories, but
     // do care about all entries which add or modify files, and
     // those which copy directories.
-    if (node->get_action() == SvnDump::File::Node::ACTION_DELETE ||
-        node->get_kind()   == SvnDump::File::Node::KIND_FILE ||
-        node->has_copy_from()) {
-      if (! repository->find_branch_by_path(node->get_path())) {
+    if (action == SvnDump::File::Node::ACTION_DELETE ||
+        kind   == SvnDump::File::Node::KIND_FILE ||
+        copy_from_rev != -1) {
+      if (! repository->lookup_branch_by_path(pathname)) {
+        result.report(rev, PrescanResult::ERROR,
+                      std::string("Failed to find a branch for: ") +
+                      pathname.string());
+
         std::ostringstream buf;
-        buf << "Could not find branch for " << node->get_path()
-            << " in r" << node->get_rev_nr();
-        status.warn(buf.str());
-        ++errors;
+        buf << "Could not find branch for " << pathname
+            << " in r" << rev;
+        result.report(rev, PrescanResult::WARN, buf.str());
+        ++result.errors;
       }
 
-      if (node->has_copy_from() &&
-          ! repository->find_branch_by_path(node->get_copy_from_path())) {
+      if (copy_from_rev != -1 &&
+          ! repository->lookup_branch_by_path(copy_from_path)) {
+        result.report(rev, PrescanResult::ERROR,
+                      std::string("Failed to find a branch for: ") +
+                      copy_from_path.string());
+
         std::ostringstream buf;
-        buf << "Could not find branch for " << node->get_copy_from_path()
-            << " in r" << node->get_rev_nr();
-        status.warn(buf.str());
-        ++errors;
+        buf << "Could not find branch for " << copy_from_path
+            << " in r" << rev;
+        result.report(rev, PrescanResult::WARN, buf.str());
+        ++result.errors;
       }
     }
   }
+}
 
-  return errors;
+/**
+ * Log what pre-scanning a node, or a whole part of the dump, found, and
+ * add its copies to the list of past trees to keep.  Returns the number
+ * of errors found.
+ */
+int ConvertRepository::merge_prescan(const PrescanResult& result)
+{
+  for (std::vector<PrescanResult::Message>::const_iterator
+         i = result.messages.begin();
+       i != result.messages.end();
+       ++i) {
+    status.update((*i).rev);
+    switch ((*i).kind) {
+    case PrescanResult::DEBUG: status.debug((*i).text); break;
+    case PrescanResult::WARN:  status.warn((*i).text);  break;
+    case PrescanResult::ERROR: status.error((*i).text); break;
+    }
+  }
+
+  for (copy_from_list::const_iterator i = result.copy_from.begin();
+       i != result.copy_from.end();
+       ++i) {
+    if (copy_from.empty() ||
+        ! (copy_from.back().first == (*i).first &&
+           copy_from.back().second == (*i).second))
+      copy_from.push_back(*i);
+  }
+
+  return result.errors;
 }
 
 void ConvertRepository::process_change(Git::Repository * repo,
@@ -468,58 +625,85 @@ void ConvertRepository::process_change(Git::Repository * repo,
                  describe_change(kind, action));
 }
 
-void ConvertRepository::operator()(SvnDump::File::Node& _node)
+/**
+ * Write out whatever the previous revision changed, and prepare to
+ * commit the revision of the current node.
+ */
+void ConvertRepository::begin_revision()
 {
-  node = &_node;
-
-  const filesystem::path& pathname(node->get_path());
-  if (! pathname.empty()) {
-    rev = node->get_rev_nr();
-    if (rev != last_rev) {
-      // Commit any changes to the repository's index.  If there were no
-      // Git-visible changes, this will be a no-op.
-      if (repository->write(last_rev)) {
-        // Record the state of the "historical tree", the one that mirrors
-        // the entire state of the Subversion filesystem.  This is
-        // necessary when we encounters revisions that copy data from
-        // older states of the tree.
+  rev = node->get_rev_nr();
+
+  // Commit any changes to the repository's index.  If there were no
+  // Git-visible changes, this will be a no-op.
+  if (repository->write(last_rev)) {
+    // Record the state of the "historical tree", the one that mirrors
+    // the entire state of the Subversion filesystem.  This is
+    // necessary when we encounters revisions that copy data from
+    // older states of the tree.
 #ifdef ASSERTS
-        std::pair<rev_trees_map::iterator, bool> result =
+    std::pair<rev_trees_map::iterator, bool> result =
 #endif
-          rev_trees.insert(rev_trees_map::value_type
-                           (last_rev, history_branch->commit->tree));
+      rev_trees.insert(rev_trees_map::value_type
+                       (last_rev, history_branch->commit->tree));
 #ifdef ASSERTS
-        assert(result.second);
+    assert(result.second);
 #endif
 
-        if (opts.collect && rev % opts.collect == 0) {
-          repository->write_branches();
-          repository->garbage_collect();
-        }
+    if (opts.collect && rev % opts.collect == 0) {
+      repository->write_branches();
+      repository->garbage_collect();
+    }
+  }
+
+  for (submodule_list_t::iterator i = submodules_list.begin();
+       i != submodules_list.end();
+       ++i)
+    if ((*i)->repository->write(last_rev)) {
+      if (opts.collect && rev % opts.collect == 0) {
+        (*i)->repository->write_branches();
+        (*i)->repository->garbage_collect();
       }
+    }
 
-      for (submodule_list_t::iterator i = submodules_list.begin();
-           i != submodules_list.end();
-           ++i)
-        if ((*i)->repository->write(last_rev)) {
-          if (opts.collect && rev % opts.collect == 0) {
-            (*i)->repository->write_branches();
-            (*i)->repository->garbage_collect();
-          }
-        }
+  free_past_trees();
 
-      free_past_trees();
+  status.update(rev);
+  last_rev = rev;
 
-      status.update(rev);
-      last_rev = rev;
+  establish_commit_info();
+}
 
-      establish_commit_info();
-    }
+void ConvertRepository::operator()(SvnDump::File::Node& _node)
+{
+  node = &_node;
+
+  const filesystem::path& pathname(node->get_path());
+  if (! pathname.empty()) {
+    if (node->get_rev_nr() != last_rev)
+      begin_revision();
 
     process_change(repository, pathname);
   }
 }
 
+/**
+ * Convert a whole revision at once.  The revision boundary is dealt
+ * with a single time, before any of its nodes.
+ */
+void ConvertRepository::operator()(SvnDump::File::Revision& batch)
+{
+  for (std::size_t i = 0; i < batch.size(); ++i) {
+    if (batch.get_path_length(i) == 0)
+      continue;
+
+    node = &batch.get_node(i);
+    if (batch.get_rev_nr() != last_rev)
+      begin_revision();
+
+    process_change(repository, node->get_path());
+  }
+}
+
 void ConvertRepository::finish()
 {
   repository->write(last_rev);
@@ -47,6 +47,30 @@ struct ConvertRepository
   typedef std::pair<int, int>        copy_from_value;
   typedef std::list<copy_from_value> copy_from_list;
 
+  // What pre-scanning part of a dump found, kept aside so that the
+  // parts can be reported in order once they are all done.
+  struct PrescanResult
+  {
+    enum Kind { DEBUG, WARN, ERROR };
+
+    struct Message {
+      int         rev;
+      Kind        kind;
+      std::string text;
+    };
+
+    copy_from_list       copy_from;
+    std::vector<Message> messages;
+    int                  errors;
+
+    PrescanResult() : errors(0) {}
+
+    void report(int rev, Kind kind, const std::string& text) {
+      Message message = { rev, kind, text };
+      messages.push_back(message);
+    }
+  };
+
   typedef std::vector<Submodule *>          submodules_list_t;
   typedef std::map<filesystem::path,
                    std::pair<filesystem::path,
@@ -125,8 +149,23 @@ struct ConvertRepository
                    const filesystem::path& pathname,
                    Git::BranchPtr          related_branch = nullptr);
 
+  bool read_base_text(const SvnDump::File::Node& node, std::string& text);
+
+  Git::ObjectPtr current_object(const filesystem::path& pathname);
+  unsigned int   file_attributes(unsigned int previous);
+
   int  prescan(SvnDump::File::Node& node);
+  void prescan(const SvnDump::File::Node& node, PrescanResult& result) const;
+  void prescan(int rev, const std::string& author_id,
+               SvnDump::File::Node::Action action,
+               SvnDump::File::Node::Kind kind,
+               const filesystem::path& pathname, int copy_from_rev,
+               const filesystem::path& copy_from_path,
+               PrescanResult& result) const;
+  int  merge_prescan(const PrescanResult& result);
+  void begin_revision();
   void operator()(SvnDump::File::Node& node);
+  void operator()(SvnDump::File::Revision& batch);
 
   void finish();
 };
@@ -0,0 +1,452 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "decompress.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace SvnDump {
+
+Decompressor::Decompressor(const filesystem::path& file, Format _format,
+                           bool _drop_behind)
+  : files(1, file), current(0), drop_behind(_drop_behind),
+    format(FORMAT_NONE), input(nullptr), advisor(nullptr), ring(RING_SIZE),
+    head(0), count(0), done(false), stopping(false)
+{
+  if (_format == FORMAT_NONE)
+    throw std::logic_error(std::string("Dump file is not compressed: ") +
+                           file.string());
+  check_support(_format, file);
+
+  open_input(0, _format);
+  start();
+}
+
+/**
+ * Every file is looked at first, so that one which is missing or cannot
+ * be decompressed is reported before any of them is read.
+ */
+Decompressor::Decompressor(const std::vector<filesystem::path>& _files,
+                           bool _drop_behind)
+  : files(_files), current(0), drop_behind(_drop_behind),
+    format(FORMAT_NONE), input(nullptr), advisor(nullptr), ring(RING_SIZE),
+    head(0), count(0), done(false), stopping(false)
+{
+  if (files.empty())
+    throw std::logic_error("No dump files to read");
+
+  for (std::vector<filesystem::path>::const_iterator i = files.begin();
+       i != files.end();
+       ++i) {
+    if (! filesystem::is_regular_file(*i))
+      throw std::logic_error(std::string("Could not open dump file: ") +
+                             (*i).string());
+    check_support(detect(*i), *i);
+  }
+
+  open_input(0, detect(files[0]));
+  start();
+}
+
+void Decompressor::check_support(Format format, const filesystem::path& file)
+{
+  switch (format) {
+  case FORMAT_NONE:
+    break;
+  case FORMAT_GZIP:
+#ifndef HAVE_ZLIB
+    throw std::logic_error(std::string("Support for gzip dump files "
+                                       "was not built: ") + file.string());
+#endif
+    break;
+  case FORMAT_XZ:
+#ifndef HAVE_LZMA
+    throw std::logic_error(std::string("Support for xz dump files "
+                                       "was not built: ") + file.string());
+#endif
+    break;
+  case FORMAT_ZSTD:
+#ifndef HAVE_ZSTD
+    throw std::logic_error(std::string("Support for zstd dump files "
+                                       "was not built: ") + file.string());
+#endif
+    break;
+  }
+}
+
+void Decompressor::open_input(std::size_t index, Format _format)
+{
+  if (input) {
+    delete advisor;
+    advisor = nullptr;
+    std::fclose(input);
+  }
+
+  current  = index;
+  pathname = files[index];
+  format   = _format;
+
+  input = std::fopen(pathname.string().c_str(), "rb");
+  if (! input)
+    throw std::logic_error(std::string("Could not open dump file: ") +
+                           pathname.string());
+  if (drop_behind)
+    advisor = new CacheAdvisor(fileno(input));
+}
+
+/**
+ * Identify a compressed dump by its leading magic bytes.
+ */
+Decompressor::Format Decompressor::detect(const filesystem::path& file)
+{
+  unsigned char magic[6] = { 0, 0, 0, 0, 0, 0 };
+
+  filesystem::ifstream in(file, std::ios::in | std::ios::binary);
+  in.read(reinterpret_cast<char *>(magic), sizeof(magic));
+
+  if (magic[0] == 0x1f && magic[1] == 0x8b)
+    return FORMAT_GZIP;
+  if (std::memcmp(magic, "\xfd" "7zXZ\0", 6) == 0)
+    return FORMAT_XZ;
+  if (magic[0] == 0x28 && magic[1] == 0xb5 &&
+      magic[2] == 0x2f && magic[3] == 0xfd)
+    return FORMAT_ZSTD;
+  return FORMAT_NONE;
+}
+
+void Decompressor::start()
+{
+  head     = 0;
+  count    = 0;
+  done     = false;
+  stopping = false;
+  failure.clear();
+
+  worker = std::thread(&Decompressor::run, this);
+}
+
+void Decompressor::stop()
+{
+  if (! worker.joinable())
+    return;
+
+  { std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  not_full.notify_all();
+  worker.join();
+}
+
+/**
+ * Begin decompressing again from the start of the first file,
+ * discarding anything still buffered.
+ */
+void Decompressor::restart()
+{
+  stop();
+  if (current == 0 && input) {
+    std::rewind(input);
+    if (advisor)
+      advisor->restart(0);
+  } else {
+    open_input(0, detect(files[0]));
+  }
+  start();
+}
+
+/**
+ * Copy up to `len' bytes of decompressed data into `buf', waiting for
+ * the producer if the ring buffer is empty.  Returns 0 at the end of
+ * the dump.
+ */
+std::size_t Decompressor::read(char * buf, std::size_t len)
+{
+  std::unique_lock<std::mutex> guard(lock);
+  not_empty.wait(guard, [this]() { return count > 0 || done; });
+
+  if (count == 0) {
+    if (! failure.empty())
+      throw std::logic_error(failure);
+    return 0;
+  }
+
+  std::size_t total = std::min(len, count);
+  std::size_t first = std::min(total, RING_SIZE - head);
+  std::memcpy(buf, &ring[head], first);
+  std::memcpy(buf + first, &ring[0], total - first);
+
+  head   = (head + total) % RING_SIZE;
+  count -= total;
+
+  guard.unlock();
+  not_full.notify_one();
+
+  return total;
+}
+
+/**
+ * Append `len' bytes to the ring buffer, waiting for the reader to make
+ * room as needed.  Returns false if the reader asked us to stop.
+ */
+bool Decompressor::push(const char * data, std::size_t len)
+{
+  while (len > 0) {
+    std::unique_lock<std::mutex> guard(lock);
+    not_full.wait(guard, [this]() { return count < RING_SIZE || stopping; });
+    if (stopping)
+      return false;
+
+    std::size_t tail  = (head + count) % RING_SIZE;
+    std::size_t total = std::min(len, RING_SIZE - count);
+    std::size_t first = std::min(total, RING_SIZE - tail);
+    std::memcpy(&ring[tail], data, first);
+    std::memcpy(&ring[0], data + first, total - first);
+
+    count += total;
+    data  += total;
+    len   -= total;
+
+    guard.unlock();
+    not_empty.notify_one();
+  }
+  return true;
+}
+
+std::size_t Decompressor::fetch(char * buf)
+{
+  std::size_t len = std::fread(buf, 1, CHUNK_SIZE, input);
+  if (len == 0 && std::ferror(input))
+    throw std::logic_error(std::string("Could not read dump file: ") +
+                           pathname.string());
+  if (advisor)
+    advisor->advance(static_cast<uint64_t>(std::ftell(input)));
+  return len;
+}
+
+void Decompressor::run()
+{
+  try {
+    for (;;) {
+      switch (format) {
+      case FORMAT_GZIP: run_gzip();  break;
+      case FORMAT_XZ:   run_xz();    break;
+      case FORMAT_ZSTD: run_zstd();  break;
+      case FORMAT_NONE: run_plain(); break;
+      }
+
+      if (current + 1 == files.size())
+        break;
+      { std::lock_guard<std::mutex> guard(lock);
+        if (stopping)
+          break;
+      }
+      open_input(current + 1, detect(files[current + 1]));
+    }
+  }
+  catch (const std::exception& err) {
+    std::lock_guard<std::mutex> guard(lock);
+    failure = err.what();
+  }
+
+  { std::lock_guard<std::mutex> guard(lock);
+    done = true;
+  }
+  not_empty.notify_all();
+}
+
+void Decompressor::run_plain()
+{
+  std::vector<char> in(CHUNK_SIZE);
+  for (;;) {
+    std::size_t len = fetch(in.data());
+    if (len == 0 || ! push(in.data(), len))
+      break;
+  }
+}
+
+void Decompressor::run_gzip()
+{
+#ifdef HAVE_ZLIB
+  std::vector<char> in(CHUNK_SIZE);
+  std::vector<char> out(CHUNK_SIZE);
+
+  z_stream strm;
+  std::memset(&strm, 0, sizeof(strm));
+
+  // 15 + 32 accepts both zlib and gzip headers
+  if (inflateInit2(&strm, 15 + 32) != Z_OK)
+    throw std::logic_error("Could not initialize zlib");
+
+  bool in_member = false;
+  for (;;) {
+    if (strm.avail_in == 0) {
+      std::size_t len = fetch(in.data());
+      if (len == 0)
+        break;
+      strm.next_in  = reinterpret_cast<Bytef *>(in.data());
+      strm.avail_in = static_cast<uInt>(len);
+    }
+
+    strm.next_out  = reinterpret_cast<Bytef *>(out.data());
+    strm.avail_out = static_cast<uInt>(out.size());
+    in_member      = true;
+
+    int ret = inflate(&strm, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+      inflateEnd(&strm);
+      throw std::logic_error(std::string("Corrupt gzip dump file: ") +
+                             pathname.string());
+    }
+
+    if (! push(out.data(), out.size() - strm.avail_out)) {
+      inflateEnd(&strm);
+      return;
+    }
+
+    // gzip files may consist of several concatenated members
+    if (ret == Z_STREAM_END) {
+      inflateReset(&strm);
+      in_member = false;
+    }
+  }
+  inflateEnd(&strm);
+
+  if (in_member)
+    throw std::logic_error(std::string("Truncated gzip dump file: ") +
+                           pathname.string());
+#endif // HAVE_ZLIB
+}
+
+void Decompressor::run_xz()
+{
+#ifdef HAVE_LZMA
+  std::vector<char> in(CHUNK_SIZE);
+  std::vector<char> out(CHUNK_SIZE);
+
+  lzma_stream strm = LZMA_STREAM_INIT;
+  if (lzma_stream_decoder(&strm, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    throw std::logic_error("Could not initialize liblzma");
+
+  lzma_action action = LZMA_RUN;
+  for (;;) {
+    if (strm.avail_in == 0 && action == LZMA_RUN) {
+      std::size_t len = fetch(in.data());
+      strm.next_in  = reinterpret_cast<const uint8_t *>(in.data());
+      strm.avail_in = len;
+      if (len == 0)
+        action = LZMA_FINISH;
+    }
+
+    strm.next_out  = reinterpret_cast<uint8_t *>(out.data());
+    strm.avail_out = out.size();
+
+    lzma_ret ret = lzma_code(&strm, action);
+    if (ret != LZMA_OK && ret != LZMA_STREAM_END) {
+      lzma_end(&strm);
+      throw std::logic_error(std::string("Corrupt xz dump file: ") +
+                             pathname.string());
+    }
+
+    if (! push(out.data(), out.size() - strm.avail_out) ||
+        ret == LZMA_STREAM_END)
+      break;
+  }
+  lzma_end(&strm);
+#endif // HAVE_LZMA
+}
+
+void Decompressor::run_zstd()
+{
+#ifdef HAVE_ZSTD
+  std::vector<char> in(CHUNK_SIZE);
+  std::vector<char> out(CHUNK_SIZE);
+
+  ZSTD_DStream * strm = ZSTD_createDStream();
+  if (! strm)
+    throw std::logic_error("Could not initialize libzstd");
+  ZSTD_initDStream(strm);
+
+  std::size_t remaining = 0;  // non-zero while a frame is incomplete
+  for (;;) {
+    std::size_t len = fetch(in.data());
+    if (len == 0)
+      break;
+
+    ZSTD_inBuffer input = { in.data(), len, 0 };
+    while (input.pos < input.size) {
+      ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+
+      remaining = ZSTD_decompressStream(strm, &output, &input);
+      if (ZSTD_isError(remaining)) {
+        ZSTD_freeDStream(strm);
+        throw std::logic_error(std::string("Corrupt zstd dump file: ") +
+                               pathname.string() + ": " +
+                               ZSTD_getErrorName(remaining));
+      }
+
+      if (! push(out.data(), output.pos)) {
+        ZSTD_freeDStream(strm);
+        return;
+      }
+    }
+  }
+
+  // Drain anything the decoder is still holding back
+  while (remaining != 0) {
+    ZSTD_inBuffer  input  = { in.data(), 0, 0 };
+    ZSTD_outBuffer output = { out.data(), out.size(), 0 };
+
+    remaining = ZSTD_decompressStream(strm, &output, &input);
+    if (ZSTD_isError(remaining) || output.pos == 0)
+      break;
+    if (! push(out.data(), output.pos)) {
+      ZSTD_freeDStream(strm);
+      return;
+    }
+  }
+  ZSTD_freeDStream(strm);
+
+  if (remaining != 0)
+    throw std::logic_error(std::string("Truncated zstd dump file: ") +
+                           pathname.string());
+#endif // HAVE_ZSTD
+}
+
+} // namespace SvnDump
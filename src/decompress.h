@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DECOMPRESS_H
+#define _DECOMPRESS_H
+
+#include "system.hpp"
+#include "pagecache.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * Decompresses a gzip, xz or zstd dump file on a background thread.
+   * The thread keeps a ring buffer filled ahead of the reader, so that
+   * decompression overlaps with parsing and conversion.
+   *
+   * It may also read a series of dump files, such as the chunks written
+   * by "svnadmin dump --incremental", as though they were one.  Each may
+   * be compressed or not.  The next file is opened and read into the
+   * ring buffer as soon as the one before it is exhausted, while the
+   * reader is still parsing the end of that one.
+   */
+  class Decompressor : public noncopyable
+  {
+  public:
+    enum Format {
+      FORMAT_NONE,
+      FORMAT_GZIP,
+      FORMAT_XZ,
+      FORMAT_ZSTD
+    };
+
+  private:
+    static const std::size_t RING_SIZE  = 8 * 1024 * 1024;
+    static const std::size_t CHUNK_SIZE = 256 * 1024;
+
+    std::vector<filesystem::path> files;
+    std::size_t                   current;      // index of `pathname'
+    bool                          drop_behind;
+
+    filesystem::path pathname;
+    Format           format;
+    std::FILE *      input;
+    CacheAdvisor *   advisor;   // drops compressed data once it is read
+
+    std::vector<char> ring;
+    std::size_t       head;     // next byte to be read
+    std::size_t       count;    // bytes available to be read
+    bool              done;     // the producer has finished
+    bool              stopping; // the reader wants the producer to quit
+    std::string       failure;
+
+    std::mutex              lock;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::thread             worker;
+
+  public:
+    Decompressor(const filesystem::path& file, Format _format,
+                 bool _drop_behind = false);
+    Decompressor(const std::vector<filesystem::path>& _files,
+                 bool _drop_behind = false);
+    ~Decompressor() {
+      stop();
+      delete advisor;
+      if (input)
+        std::fclose(input);
+    }
+
+    static Format detect(const filesystem::path& file);
+
+    std::size_t read(char * buf, std::size_t len);
+    void        restart();
+
+  private:
+    static void check_support(Format format, const filesystem::path& file);
+
+    void open_input(std::size_t index, Format _format);
+    void start();
+    void stop();
+    void run();
+
+    std::size_t fetch(char * buf);
+    bool        push(const char * data, std::size_t len);
+
+    void run_plain();
+    void run_gzip();
+    void run_xz();
+    void run_zstd();
+  };
+}
+
+#endif // _DECOMPRESS_H
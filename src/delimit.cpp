@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "delimit.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH
+#endif
+
+namespace SvnDump {
+
+namespace {
+  inline const char * scan_scalar(const char * p, const char * end,
+                                  const char *& colon)
+  {
+    for (; p < end; ++p) {
+      if (*p == '\n')
+        return p;
+      if (*p == ':' && ! colon)
+        colon = p;
+    }
+    return nullptr;
+  }
+
+  /**
+   * Given the newline and colon bit masks for a block starting at `p',
+   * note the first colon ahead of any newline and return the newline.
+   */
+  inline const char * scan_masks(const char * p, unsigned nl_mask,
+                                 unsigned colon_mask, const char *& colon)
+  {
+    if (! colon && colon_mask) {
+      unsigned at = static_cast<unsigned>(__builtin_ctz(colon_mask));
+      if (! nl_mask || at < static_cast<unsigned>(__builtin_ctz(nl_mask)))
+        colon = p + at;
+    }
+    return nl_mask ? p + __builtin_ctz(nl_mask) : nullptr;
+  }
+
+#if defined(__SSE2__)
+  const char * scan_sse2(const char * p, const char * end,
+                         const char *& colon)
+  {
+    const __m128i nl = _mm_set1_epi8('\n');
+    const __m128i cl = _mm_set1_epi8(':');
+
+    for (; end - p >= 16; p += 16) {
+      __m128i  block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      unsigned nl_mask =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, nl)));
+      unsigned colon_mask =
+        static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, cl)));
+      if (nl_mask || (colon_mask && ! colon))
+        if (const char * found = scan_masks(p, nl_mask, colon_mask, colon))
+          return found;
+    }
+    return scan_scalar(p, end, colon);
+  }
+#endif // __SSE2__
+
+#if defined(HAVE_AVX2_DISPATCH)
+  __attribute__((target("avx2")))
+  const char * scan_avx2(const char * p, const char * end,
+                         const char *& colon)
+  {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    const __m256i cl = _mm256_set1_epi8(':');
+
+    for (; end - p >= 32; p += 32) {
+      __m256i  block =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      unsigned nl_mask = static_cast<unsigned>
+        (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, nl)));
+      unsigned colon_mask = static_cast<unsigned>
+        (_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, cl)));
+      if (nl_mask || (colon_mask && ! colon))
+        if (const char * found = scan_masks(p, nl_mask, colon_mask, colon))
+          return found;
+    }
+#if defined(__SSE2__)
+    return scan_sse2(p, end, colon);
+#else
+    return scan_scalar(p, end, colon);
+#endif
+  }
+#endif // HAVE_AVX2_DISPATCH
+
+  typedef const char * (*scan_function)(const char *, const char *,
+                                        const char *&);
+
+  scan_function choose_scanner()
+  {
+#if defined(HAVE_AVX2_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+      return scan_avx2;
+#endif
+#if defined(__SSE2__)
+    return scan_sse2;
+#else
+    return scan_scalar;
+#endif
+  }
+}
+
+const char * find_line_end(const char * p, const char * end,
+                           const char *& colon)
+{
+  static const scan_function scan = choose_scanner();
+
+  colon = nullptr;
+  return scan(p, end, colon);
+}
+
+} // namespace SvnDump
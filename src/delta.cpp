@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "delta.h"
+
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace SvnDump {
+
+namespace {
+  void corrupt_delta()
+  {
+    throw std::logic_error("Corrupt svndiff text delta");
+  }
+
+  /**
+   * Read one of svndiff's variable-length integers: seven bits per byte,
+   * most significant first, with the high bit set on all but the last.
+   */
+  std::size_t read_varint(const char *& p, const char * end)
+  {
+    std::size_t value = 0;
+    while (p < end) {
+      unsigned char c = static_cast<unsigned char>(*p++);
+      value = (value << 7) | (c & 0x7f);
+      if (! (c & 0x80))
+        return value;
+    }
+    corrupt_delta();
+    return 0;
+  }
+
+  /**
+   * In svndiff1, the instruction and new data sections of each window
+   * begin with their original length, and are zlib compressed unless
+   * that would not have made them smaller.
+   */
+  const char * decode_section(const char * p, std::size_t len,
+                              std::string& buffer, std::size_t& out_len)
+  {
+    const char * end  = p + len;
+    std::size_t  orig = read_varint(p, end);
+    std::size_t  left = static_cast<std::size_t>(end - p);
+
+    out_len = orig;
+    if (left == orig)
+      return p;
+
+#ifdef HAVE_ZLIB
+    buffer.resize(orig);
+    uLongf dest_len = static_cast<uLongf>(orig);
+    if (::uncompress(reinterpret_cast<Bytef *>(&buffer[0]), &dest_len,
+                     reinterpret_cast<const Bytef *>(p),
+                     static_cast<uLong>(left)) != Z_OK ||
+        dest_len != orig)
+      corrupt_delta();
+    return buffer.data();
+#else
+    throw std::logic_error("Support for compressed (svndiff1) text deltas "
+                           "was not built");
+#endif
+  }
+}
+
+void svn_decompress(const char * data, std::size_t len, std::string& out)
+{
+  std::size_t  out_len;
+  const char * p = decode_section(data, len, out, out_len);
+  if (p != out.data())
+    out.assign(p, out_len);
+}
+
+void apply_svndiff(const char * delta,  std::size_t delta_len,
+                   const char * source, std::size_t source_len,
+                   std::string& target)
+{
+  if (delta_len == 0)
+    return;
+  if (delta_len < 4 || std::memcmp(delta, "SVN", 3) != 0)
+    corrupt_delta();
+
+  int version = delta[3];
+  if (version != 0 && version != 1)
+    throw std::logic_error("Unsupported svndiff version in text delta");
+
+  const char * p   = delta + 4;
+  const char * end = delta + delta_len;
+
+  std::string ins_buffer;
+  std::string data_buffer;
+
+  while (p < end) {
+    std::size_t sview_offset = read_varint(p, end);
+    std::size_t sview_len    = read_varint(p, end);
+    std::size_t tview_len    = read_varint(p, end);
+    std::size_t ins_len      = read_varint(p, end);
+    std::size_t data_len     = read_varint(p, end);
+
+    if (static_cast<std::size_t>(end - p) < ins_len + data_len ||
+        sview_offset > source_len || sview_len > source_len - sview_offset)
+      corrupt_delta();
+
+    const char * ins  = p;
+    const char * data = p + ins_len;
+    p += ins_len + data_len;
+
+    if (version == 1) {
+      ins  = decode_section(ins, ins_len, ins_buffer, ins_len);
+      data = decode_section(data, data_len, data_buffer, data_len);
+    }
+
+    const char * sview     = source + sview_offset;
+    const char * ins_end   = ins + ins_len;
+    std::size_t  data_pos  = 0;
+    std::size_t  tview_pos = target.size();
+
+    target.reserve(tview_pos + tview_len);
+
+    while (ins < ins_end) {
+      unsigned char c   = static_cast<unsigned char>(*ins++);
+      std::size_t   len = c & 0x3f;
+      if (len == 0)
+        len = read_varint(ins, ins_end);
+
+      switch (c >> 6) {
+      case 0: {                 // copy from the source view
+        std::size_t offset = read_varint(ins, ins_end);
+        if (offset > sview_len || len > sview_len - offset)
+          corrupt_delta();
+        target.append(sview + offset, len);
+        break;
+      }
+      case 1: {                 // copy from the target view so far
+        std::size_t offset = read_varint(ins, ins_end);
+        if (offset >= target.size() - tview_pos)
+          corrupt_delta();
+        // The copy may overlap what it produces, so go byte by byte
+        std::size_t from = tview_pos + offset;
+        for (std::size_t i = 0; i < len; ++i)
+          target.push_back(target[from + i]);
+        break;
+      }
+      case 2:                   // copy new data
+        if (len > data_len - data_pos)
+          corrupt_delta();
+        target.append(data + data_pos, len);
+        data_pos += len;
+        break;
+      default:
+        corrupt_delta();
+      }
+    }
+
+    if (target.size() - tview_pos != tview_len)
+      corrupt_delta();
+  }
+}
+
+TextCache::text_ptr TextCache::find(const std::string& md5)
+{
+  lru_map::iterator i = by_md5.find(md5);
+  if (i == by_md5.end())
+    return text_ptr();
+
+  entries.splice(entries.begin(), entries, (*i).second);
+  return (*(*i).second).second;
+}
+
+void TextCache::insert(const std::string& md5, text_ptr text)
+{
+  if (text->size() > capacity || by_md5.find(md5) != by_md5.end())
+    return;
+
+  entries.push_front(std::make_pair(md5, text));
+  by_md5.insert(lru_map::value_type(md5, entries.begin()));
+  size += text->size();
+
+  while (size > capacity) {
+    size -= entries.back().second->size();
+    by_md5.erase(entries.back().first);
+    entries.pop_back();
+  }
+}
+
+void TextCache::clear()
+{
+  entries.clear();
+  by_md5.clear();
+  size = 0;
+}
+
+} // namespace SvnDump
@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _DELTA_H
+#define _DELTA_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * Apply a text delta in svndiff format, versions 0 and 1, to the text
+   * `source', appending the result to `target'.  Version 1 deltas are
+   * zlib compressed and need HAVE_ZLIB.
+   */
+  void apply_svndiff(const char * delta,  std::size_t delta_len,
+                     const char * source, std::size_t source_len,
+                     std::string& target);
+
+  /**
+   * Undo Subversion's svn__compress(), used for the sections of svndiff1
+   * windows and for an FSFS repository's packed revision properties: the
+   * original length, followed by the data, zlib compressed unless that
+   * would not have made it smaller.
+   */
+  void svn_decompress(const char * data, std::size_t len, std::string& out);
+
+  /**
+   * Keeps the most recently produced full texts of a deltified dump,
+   * keyed by their MD5 checksum, so that later deltas against them need
+   * not go back to the Git object database.  The least recently used
+   * texts are dropped once `capacity' bytes are held.
+   */
+  class TextCache : public noncopyable
+  {
+  public:
+    typedef shared_ptr<const std::string> text_ptr;
+
+  private:
+    typedef std::list<std::pair<std::string, text_ptr> > lru_list;
+    typedef std::map<std::string, lru_list::iterator>    lru_map;
+
+    lru_list    entries;            // most recently used first
+    lru_map     by_md5;
+    std::size_t capacity;
+    std::size_t size;
+
+  public:
+    static const std::size_t DEFAULT_CAPACITY = 64 * 1024 * 1024;
+
+    TextCache(std::size_t _capacity = DEFAULT_CAPACITY)
+      : capacity(_capacity), size(0) {}
+
+    text_ptr find(const std::string& md5);
+    void     insert(const std::string& md5, text_ptr text);
+    void     clear();
+  };
+}
+
+#endif // _DELTA_H
@@ -0,0 +1,529 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "dumpfilter.h"
+#include "archive.h"
+#include "pathfilter.h"
+
+namespace SvnDump {
+
+namespace {
+  std::string parent_of(const std::string& path)
+  {
+    std::string::size_type slash = path.rfind('/');
+    return slash == std::string::npos ? std::string() : path.substr(0, slash);
+  }
+
+  // `path', which is `dir' or lies within it, moved to `to' instead
+  std::string rebase(const std::string& path, const std::string& dir,
+                     const std::string& to)
+  {
+    std::string rest(dir.empty() || path.size() == dir.size() ?
+                     path.substr(dir.size()) : path.substr(dir.size() + 1));
+    if (to.empty())
+      return rest;
+    return rest.empty() ? to : to + "/" + rest;
+  }
+}
+
+DumpFilter::DumpFilter(File& dump, const filesystem::path& _dump_path,
+                       const PathFilter& _filter,
+                       const filesystem::path& output)
+  : filter(_filter), dump_path(_dump_path), pathname(output), in_fd(-1),
+    out_fd(-1), out_is_pipe(false), use_copy_range(true), started(false),
+    buffer(1024 * 1024), kept_nodes(0), rewritten_copies(0),
+    added_nodes(0), copied_bytes(0)
+{
+  // Records are copied out of the dump file by their offsets, which
+  // only an uncompressed dump file has
+  if (dump_path == "-" || ! filesystem::is_regular_file(dump_path) ||
+      Decompressor::detect(dump_path) != Decompressor::FORMAT_NONE ||
+      Archive::detect(dump_path))
+    throw std::logic_error(std::string("Only an uncompressed dump file "
+                                       "can be filtered: ") +
+                           dump_path.string());
+
+  in_fd = ::open(dump_path.string().c_str(), O_RDONLY);
+  if (in_fd < 0)
+    throw std::logic_error(std::string("Could not open dump file: ") +
+                           dump_path.string());
+
+  if (output == "-") {
+    out_fd = STDOUT_FILENO;
+  } else {
+    tmp_pathname = output.string() + ".tmp";
+    out_fd = ::open(tmp_pathname.string().c_str(),
+                    O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (out_fd < 0) {
+      ::close(in_fd);
+      throw std::logic_error(std::string("Could not create dump file: ") +
+                             tmp_pathname.string());
+    }
+  }
+
+  struct stat st;
+  out_is_pipe = ::fstat(out_fd, &st) == 0 && S_ISFIFO(st.st_mode);
+
+  dump.set_revision_handler
+    (bind(&DumpFilter::add_revision, this, _1, _2, _3));
+}
+
+DumpFilter::~DumpFilter()
+{
+  ::close(in_fd);
+  if (! tmp_pathname.empty()) {
+    ::close(out_fd);
+    // Unless finished, the output is incomplete
+    boost::system::error_code ec;
+    filesystem::remove(tmp_pathname, ec);
+  }
+}
+
+/**
+ * Write the next node, if the filter keeps it, and note what it did to
+ * its path.  Copies from paths the filter does not wholly include are
+ * written as adds instead.
+ */
+void DumpFilter::add(const File::Node& node)
+{
+  std::string      path(node.pathname.string());
+  PathFilter::Match match(filter.match(path));
+
+  if (match != PathFilter::EXCLUDED) {
+    if (node.copy_from_rev && node.copy_from_path &&
+        (node.action == File::Node::ACTION_ADD ||
+         node.action == File::Node::ACTION_REPLACE) &&
+        filter.match(node.copy_from_path->string()) !=
+        PathFilter::INCLUDED) {
+      write_copy(node);
+    } else {
+      uint64_t end = node.header_offset + node.header_len;
+      if (node.props_len > 0)
+        end = node.props_offset + node.props_len;
+      if (node.text_size > 0)
+        end = node.text_offset + node.text_size;
+
+      copy(node.header_offset, end - node.header_offset);
+      pending += end > node.header_offset + node.header_len ? "\n\n" : "\n";
+    }
+    ++kept_nodes;
+  }
+
+  record(node);
+}
+
+void DumpFilter::finish()
+{
+  // A dump without revisions is copied as it is
+  if (! started) {
+    copy(0, filesystem::file_size(dump_path));
+    started = true;
+  }
+  flush();
+
+  if (! tmp_pathname.empty()) {
+    if (::close(out_fd) != 0)
+      throw std::logic_error(std::string("Could not write dump file: ") +
+                             tmp_pathname.string());
+    filesystem::rename(tmp_pathname, pathname);
+    tmp_pathname.clear();
+  }
+}
+
+/**
+ * Every revision record is copied, preceded by the dump's own headers
+ * the first time.
+ */
+void DumpFilter::add_revision(int, uint64_t offset, uint64_t len)
+{
+  if (! started) {
+    copy(0, offset);
+    started = true;
+  }
+  copy(offset, len);
+  pending += "\n";
+}
+
+/**
+ * Note what `node' did to its path.  The text and properties a file
+ * ends up with are worked out now, while those of a directory's copy
+ * are left to be found from its source when asked for.
+ */
+void DumpFilter::record(const File::Node& node)
+{
+  std::string path(node.pathname.string());
+
+  Event event;
+  event.rev      = node.curr_rev;
+  event.from_rev = -1;
+
+  if (node.action == File::Node::ACTION_DELETE) {
+    event.type = Event::DELETED;
+  }
+  else if (node.action == File::Node::ACTION_CHANGE) {
+    event.type = Event::CHANGED;
+    resolve(path, event.rev, event.state);
+  }
+  else if (node.copy_from_rev && node.copy_from_path) {
+    if (node.kind == File::Node::KIND_DIR) {
+      event.type      = Event::COPIED;
+      event.from_path = node.copy_from_path->string();
+      event.from_rev  = *node.copy_from_rev;
+    } else {
+      event.type = Event::ADDED;
+      resolve(node.copy_from_path->string(), *node.copy_from_rev,
+              event.state);
+    }
+  }
+  else {
+    event.type = Event::ADDED;
+  }
+
+  if (event.type != Event::DELETED) {
+    State& state(event.state);
+    if (node.kind != File::Node::KIND_NONE)
+      state.kind = node.kind;
+
+    if (node.props_len > 0) {
+      state.props_offset = node.props_offset;
+      state.props_len    = node.props_len;
+      state.delta       |= node.props_delta;
+    }
+
+    // A text made empty has no body, but still has its checksum
+    if (node.text_size > 0 || node.md5_checksum) {
+      state.text_offset = node.text_offset;
+      state.text_size   = node.text_size;
+      state.md5         = node.md5_checksum ? *node.md5_checksum : "";
+      state.sha1        = node.sha1_checksum ? *node.sha1_checksum : "";
+      state.delta      |= node.text_delta;
+    }
+  }
+
+  history[path].push_back(event);
+}
+
+/**
+ * The event which decides what `path' was in revision `rev': the latest
+ * of its own, or of those of its parents which replace what is below
+ * them.  Within one revision, the deepest path's event is the later.
+ * `at' is set to the path the event is for.  If `structural' is true,
+ * the path's own changes are passed over too, to find what decides
+ * what lies below it.
+ */
+const DumpFilter::Event *
+DumpFilter::find_event(const std::string& path, int rev, std::string& at,
+                       bool structural) const
+{
+  const Event * found = nullptr;
+  std::string   p(path);
+
+  for (bool self = ! structural; ; self = false) {
+    history_map::const_iterator i = history.find(p);
+    if (i != history.end()) {
+      const std::vector<Event>& events(i->second);
+      std::vector<Event>::const_iterator j =
+        std::upper_bound(events.begin(), events.end(), rev,
+                         [](int value, const Event& event) {
+                           return value < event.rev;
+                         });
+      while (j != events.begin()) {
+        --j;
+        if (! self && (*j).type == Event::CHANGED)
+          continue;
+        if (! found || (*j).rev > found->rev) {
+          found = &*j;
+          at    = p;
+        }
+        break;
+      }
+    }
+    if (p.empty())
+      break;
+    p = parent_of(p);
+  }
+  return found;
+}
+
+/**
+ * What `path' was in revision `rev', following copies back to their
+ * sources.  Returns false if it did not exist.
+ */
+bool DumpFilter::resolve(const std::string& path, int rev,
+                         State& state) const
+{
+  std::string   at;
+  const Event * event = find_event(path, rev, at);
+  if (! event || event->type == Event::DELETED)
+    return false;
+
+  if (at == path) {
+    state = event->state;
+    if (event->type == Event::COPIED && state.props_len == 0) {
+      State source;
+      if (resolve(event->from_path, event->from_rev, source)) {
+        state.props_offset = source.props_offset;
+        state.props_len    = source.props_len;
+        state.delta       |= source.delta;
+      }
+    }
+    return true;
+  }
+
+  // Below a directory added afresh, only paths of its own exist
+  if (event->type != Event::COPIED)
+    return false;
+  return resolve(rebase(path, at, event->from_path), event->from_rev, state);
+}
+
+/**
+ * Add to `paths' everything below `dir' in revision `rev': the paths
+ * recorded there, those the directory's copy brought with it, and those
+ * copied into directories below it in turn.
+ */
+void DumpFilter::subtree(const std::string& dir, int rev,
+                         std::set<std::string>& paths) const
+{
+  std::set<std::string> candidates;
+  std::string           prefix(dir.empty() ? dir : dir + "/");
+
+  for (history_map::const_iterator i = history.lower_bound(prefix);
+       i != history.end() && starts_with(i->first, prefix);
+       ++i) {
+    if (i->first.empty() || i->second.front().rev > rev)
+      continue;
+    candidates.insert(i->first);
+
+    std::string   at;
+    const Event * event = find_event(i->first, rev, at, true);
+    if (event && event->type == Event::COPIED && at == i->first)
+      subtree(i->first, rev, candidates);
+  }
+
+  std::string   at;
+  const Event * event = find_event(dir, rev, at, true);
+  if (event && event->type == Event::COPIED) {
+    std::string source(rebase(dir, at, event->from_path));
+
+    std::set<std::string> copied;
+    subtree(source, event->from_rev, copied);
+    for (std::set<std::string>::const_iterator i = copied.begin();
+         i != copied.end();
+         ++i)
+      candidates.insert(rebase(*i, source, dir));
+  }
+
+  State state;
+  for (std::set<std::string>::const_iterator i = candidates.begin();
+       i != candidates.end();
+       ++i)
+    if (resolve(*i, rev, state))
+      paths.insert(*i);
+}
+
+/**
+ * Write a copy from outside the filter as an add of the path copied,
+ * with the text and properties the copy itself gave it, and then of
+ * each path below it which the filter keeps.  Parents sort before
+ * their children, so each is added after its directory.
+ */
+void DumpFilter::write_copy(const File::Node& node)
+{
+  std::string path(node.pathname.string());
+  std::string from(node.copy_from_path->string());
+  int         from_rev = *node.copy_from_rev;
+
+  State state;
+  if (! resolve(from, from_rev, state))
+    throw std::logic_error("Copy source " + from + "@" +
+                           lexical_cast<std::string>(from_rev) +
+                           " of " + path + " does not exist");
+
+  // The copy's own text and properties win over the source's
+  if (node.props_len > 0) {
+    state.props_offset = node.props_offset;
+    state.props_len    = node.props_len;
+    state.delta       |= node.props_delta;
+  }
+  if (node.text_size > 0 || node.md5_checksum) {
+    state.text_offset = node.text_offset;
+    state.text_size   = node.text_size;
+    state.md5         = node.md5_checksum ? *node.md5_checksum : "";
+    state.sha1        = node.sha1_checksum ? *node.sha1_checksum : "";
+    state.delta      |= node.text_delta;
+  }
+
+  write_add(path, node.action == File::Node::ACTION_REPLACE ?
+            "replace" : "add", state);
+  ++rewritten_copies;
+  ++added_nodes;
+
+  if (state.kind != File::Node::KIND_DIR)
+    return;
+
+  std::set<std::string> paths;
+  subtree(from, from_rev, paths);
+
+  for (std::set<std::string>::const_iterator i = paths.begin();
+       i != paths.end();
+       ++i) {
+    std::string       dest(rebase(*i, from, path));
+    PathFilter::Match match(filter.match(dest));
+    if (match == PathFilter::EXCLUDED)
+      continue;
+
+    State entry;
+    resolve(*i, from_rev, entry);
+    if (match == PathFilter::ANCESTOR &&
+        entry.kind != File::Node::KIND_DIR)
+      continue;
+
+    write_add(dest, "add", entry);
+    ++added_nodes;
+  }
+}
+
+void DumpFilter::write_add(const std::string& path, const char * action,
+                           const State& state)
+{
+  if (state.delta)
+    throw std::logic_error("Cannot write " + path + " in full, as the "
+                           "dump only has a delta of it");
+
+  bool        is_file   = state.kind != File::Node::KIND_DIR;
+  std::size_t props_len = state.props_len > 0 ? state.props_len : 10;
+  std::size_t text_len  = is_file ? state.text_size : 0;
+
+  std::ostringstream headers;
+  headers << "Node-path: " << path << '\n'
+          << "Node-kind: " << (is_file ? "file" : "dir") << '\n'
+          << "Node-action: " << action << '\n';
+  if (is_file && ! state.md5.empty())
+    headers << "Text-content-md5: " << state.md5 << '\n';
+  if (is_file && ! state.sha1.empty())
+    headers << "Text-content-sha1: " << state.sha1 << '\n';
+  headers << "Prop-content-length: " << props_len << '\n';
+  if (is_file)
+    headers << "Text-content-length: " << text_len << '\n';
+  headers << "Content-length: " << props_len + text_len << "\n\n";
+  pending += headers.str();
+
+  if (state.props_len > 0)
+    copy(state.props_offset, state.props_len);
+  else
+    pending += "PROPS-END\n";
+  if (text_len > 0)
+    copy(state.text_offset, text_len);
+  pending += "\n\n";
+}
+
+/**
+ * Copy `len' bytes of the dump at `offset' to the output.  Between two
+ * files, copy_file_range(2) has the kernel copy them, sharing their
+ * extents if the filesystem can; into a pipe, splice(2) moves them
+ * from the page cache.  Anything else is read and written.
+ */
+void DumpFilter::copy(uint64_t offset, uint64_t len)
+{
+  flush();
+  copied_bytes += len;
+
+#ifdef HAVE_COPY_FILE_RANGE
+  while (len > 0 && use_copy_range && ! out_is_pipe) {
+    loff_t  from = static_cast<loff_t>(offset);
+    ssize_t n    = ::copy_file_range(in_fd, &from, out_fd, nullptr,
+                                     static_cast<std::size_t>(len), 0);
+    if (n < 0 && (errno == EXDEV || errno == EINVAL || errno == ENOSYS ||
+                  errno == EOPNOTSUPP)) {
+      use_copy_range = false;
+      break;
+    }
+    if (n <= 0)
+      throw std::logic_error(std::string("Could not copy from dump file: ") +
+                             dump_path.string());
+    offset += static_cast<uint64_t>(n);
+    len    -= static_cast<uint64_t>(n);
+  }
+#endif
+
+#ifdef HAVE_SPLICE
+  while (len > 0 && out_is_pipe) {
+    loff_t  from = static_cast<loff_t>(offset);
+    ssize_t n    = ::splice(in_fd, &from, out_fd, nullptr,
+                            static_cast<std::size_t>(len), SPLICE_F_MORE);
+    if (n < 0 && errno == EINVAL)
+      break;
+    if (n <= 0)
+      throw std::logic_error(std::string("Could not copy from dump file: ") +
+                             dump_path.string());
+    offset += static_cast<uint64_t>(n);
+    len    -= static_cast<uint64_t>(n);
+  }
+#endif
+
+  while (len > 0) {
+    std::size_t want = static_cast<std::size_t>
+      (std::min<uint64_t>(len, buffer.size()));
+    ssize_t n = ::pread(in_fd, buffer.data(), want,
+                        static_cast<off_t>(offset));
+    if (n <= 0)
+      throw std::logic_error(std::string("Could not read dump file: ") +
+                             dump_path.string());
+    write(buffer.data(), static_cast<std::size_t>(n));
+    offset += static_cast<uint64_t>(n);
+    len    -= static_cast<uint64_t>(n);
+  }
+}
+
+void DumpFilter::write(const char * data, std::size_t len)
+{
+  while (len > 0) {
+    ssize_t n = ::write(out_fd, data, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      throw std::logic_error(std::string("Could not write dump file: ") +
+                             (tmp_pathname.empty() ? std::string("-") :
+                              tmp_pathname.string()));
+    data += n;
+    len  -= static_cast<std::size_t>(n);
+  }
+}
+
+void DumpFilter::flush()
+{
+  write(pending.data(), pending.size());
+  pending.clear();
+}
+
+} // namespace SvnDump
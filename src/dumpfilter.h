@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _DUMPFILTER_H
+#define _DUMPFILTER_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  class PathFilter;
+
+  /**
+   * Writes the nodes of a dump which a PathFilter includes to a new
+   * dump, for "subconvert filter".  Every revision is kept, even when
+   * none of its nodes are, so that revision numbers stay the same.
+   *
+   * Only the headers of the input are parsed.  The records kept are
+   * copied out of the dump file whole, by the kernel where it can:
+   * with copy_file_range(2) to a file, or splice(2) to a pipe.
+   *
+   * A copy into the filter from a path outside it is written instead as
+   * an add of everything the copy brought in, with the texts and
+   * properties they had at the source revision.  For that, the history
+   * of every path in the dump is kept as it is read, noting where its
+   * text and properties lie in the dump.  A directory's copy is only
+   * noted, and followed back to its source when it is needed.
+   */
+  class DumpFilter : public noncopyable
+  {
+    // What a path was as of some revision
+    struct State {
+      File::Node::Kind kind;
+      uint64_t         text_offset;
+      std::size_t      text_size;
+      uint64_t         props_offset;
+      std::size_t      props_len;   // zero if it has no property block
+      bool             delta;       // either of them is a delta
+      std::string      md5;
+      std::string      sha1;
+
+      State() : kind(File::Node::KIND_NONE), text_offset(0), text_size(0),
+                props_offset(0), props_len(0), delta(false) {}
+    };
+
+    // A node's effect on its path.  Only CHANGED leaves what lies below
+    // a directory as it was.
+    struct Event {
+      enum Type {
+        ADDED,
+        CHANGED,
+        COPIED,                 // a directory, with all below it
+        DELETED
+      };
+
+      int         rev;
+      Type        type;
+      State       state;        // of a COPIED one, just its own properties
+      std::string from_path;
+      int         from_rev;
+    };
+
+    typedef std::map<std::string, std::vector<Event> > history_map;
+
+    const PathFilter& filter;
+    filesystem::path  dump_path;
+    filesystem::path  pathname;
+    filesystem::path  tmp_pathname;     // empty when writing to stdout
+    int               in_fd;
+    int               out_fd;
+    bool              out_is_pipe;
+    bool              use_copy_range;
+    bool              started;          // the dump's preamble is written
+    std::string       pending;          // headers not yet written
+    std::vector<char> buffer;
+    history_map       history;
+
+    std::size_t kept_nodes;
+    std::size_t rewritten_copies;
+    std::size_t added_nodes;
+    uint64_t    copied_bytes;
+
+  public:
+    // `dump' must be read from the uncompressed dump file `_dump_path';
+    // its revisions are written as it parses them.  An `output' of "-"
+    // is standard output.
+    DumpFilter(File& dump, const filesystem::path& _dump_path,
+               const PathFilter& _filter, const filesystem::path& output);
+    ~DumpFilter();
+
+    void add(const File::Node& node);
+    void finish();
+
+    std::size_t get_kept_nodes() const {
+      return kept_nodes;
+    }
+    std::size_t get_rewritten_copies() const {
+      return rewritten_copies;
+    }
+    std::size_t get_added_nodes() const {
+      return added_nodes;
+    }
+    uint64_t get_copied_bytes() const {
+      return copied_bytes;
+    }
+
+  private:
+    void add_revision(int rev, uint64_t offset, uint64_t len);
+    void record(const File::Node& node);
+
+    const Event * find_event(const std::string& path, int rev,
+                             std::string& at, bool structural = false) const;
+    bool resolve(const std::string& path, int rev, State& state) const;
+    void subtree(const std::string& dir, int rev,
+                 std::set<std::string>& paths) const;
+
+    void write_copy(const File::Node& node);
+    void write_add(const std::string& path, const char * action,
+                   const State& state);
+    void copy(uint64_t offset, uint64_t len);
+    void write(const char * data, std::size_t len);
+    void flush();
+  };
+}
+
+#endif // _DUMPFILTER_H
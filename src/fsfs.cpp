@@ -0,0 +1,1000 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "fsfs.h"
+
+namespace SvnDump {
+
+namespace {
+  typedef std::map<std::string, std::string> hash_map;
+
+  void corrupt(const std::string& what)
+  {
+    throw std::logic_error("Corrupt FSFS repository: " + what);
+  }
+
+  std::string read_file(const filesystem::path& path)
+  {
+    filesystem::ifstream in(path, std::ios::in | std::ios::binary);
+    if (! in.good())
+      throw std::logic_error(std::string("Could not read ") + path.string());
+    std::ostringstream buf;
+    buf << in.rdbuf();
+    return buf.str();
+  }
+
+  uint64_t to_number(const std::string& str)
+  {
+    char * last;
+    if (str.empty() || str[0] < '0' || str[0] > '9')
+      corrupt("expected a number, not \"" + str + "\"");
+    uint64_t value = std::strtoull(str.c_str(), &last, 10);
+    if (*last != '\0')
+      corrupt("expected a number, not \"" + str + "\"");
+    return value;
+  }
+
+  /**
+   * Take the line at `p' into `line', without its newline, and move `p'
+   * past it.  Returns false if there is nothing left before `end'.
+   */
+  bool next_line(const char *& p, const char * end, std::string& line)
+  {
+    if (p >= end)
+      return false;
+    const char * q = static_cast<const char *>(std::memchr(p, '\n', end - p));
+    if (! q)
+      q = end;
+    line.assign(p, q);
+    p = q < end ? q + 1 : end;
+    return true;
+  }
+
+  std::vector<std::string> split(const std::string& line)
+  {
+    std::vector<std::string> tokens;
+    std::istringstream in(line);
+    std::string token;
+    while (in >> token)
+      tokens.push_back(token);
+    return tokens;
+  }
+
+  /**
+   * Read the variable-length integers of a log-to-phys index, seven
+   * bits to a byte, least significant first.
+   */
+  uint64_t read_packed(const char *& p, const char * end)
+  {
+    uint64_t value = 0;
+    for (unsigned shift = 0; p < end && shift < 64; shift += 7) {
+      unsigned char c = static_cast<unsigned char>(*p++);
+      value |= static_cast<uint64_t>(c & 0x7f) << shift;
+      if (! (c & 0x80))
+        return value;
+    }
+    corrupt("bad log-to-phys index");
+    return 0;
+  }
+
+  /**
+   * Parse a hash as svn_hash_write2() writes it, "K <len>" and "V <len>"
+   * lines each followed by that much data, up to a line saying "END".
+   * Returns the end of it.
+   */
+  const char * parse_hash(const char * p, const char * end, hash_map& hash)
+  {
+    std::string line;
+    for (;;) {
+      if (! next_line(p, end, line))
+        corrupt("unterminated property list");
+      if (line == "END")
+        return p;
+
+      std::string key;
+      for (int i = 0; i < 2; ++i) {
+        if (line.size() < 3 || line[0] != (i == 0 ? 'K' : 'V') ||
+            line[1] != ' ')
+          corrupt("bad property list");
+        uint64_t len = to_number(line.substr(2));
+        if (static_cast<uint64_t>(end - p) < len + 1 || p[len] != '\n')
+          corrupt("bad property list");
+        if (i == 0) {
+          key.assign(p, len);
+          p += len + 1;
+          if (! next_line(p, end, line))
+            corrupt("unterminated property list");
+        } else {
+          hash[key].assign(p, len);
+          p += len + 1;
+        }
+      }
+    }
+  }
+
+  /**
+   * The order in which "svnadmin dump" gives the paths of a revision:
+   * depth first, so that a directory's children follow it directly.
+   */
+  bool path_less(const std::string& a, const std::string& b)
+  {
+    std::size_t n = std::min(a.size(), b.size());
+    for (std::size_t i = 0; i < n; ++i)
+      if (a[i] != b[i]) {
+        if (a[i] == '/')
+          return true;
+        if (b[i] == '/')
+          return false;
+        return (static_cast<unsigned char>(a[i]) <
+                static_cast<unsigned char>(b[i]));
+      }
+    return a.size() < b.size();
+  }
+
+  bool is_within(const std::string& path, const std::string& dir)
+  {
+    return (path.size() > dir.size() && path[dir.size()] == '/' &&
+            path.compare(0, dir.size(), dir) == 0);
+  }
+
+  // One entry of a revision's changed-path list
+  struct RawChange
+  {
+    std::string        path;
+    std::string        id;      // of the node-revision
+    File::Node::Kind   kind;
+    File::Node::Action action;
+    bool               text_mod;
+    bool               prop_mod;
+    int                copy_from_rev;
+    std::string        copy_from_path;
+  };
+
+  /**
+   * Parse a revision's changed-path list, two lines to a change:
+   *
+   *   <id> <action>[-<kind>] <text-mod> <prop-mod> [<mergeinfo-mod>] <path>
+   *   [<copy-from-rev> <copy-from-path>]
+   *
+   * and fold the changes made to each path into one, the way
+   * svn_fs_paths_changed2() does.
+   */
+  void parse_changes(const char * p, const char * end,
+                     std::vector<RawChange>& changes)
+  {
+    std::map<std::string, RawChange> folded;
+    std::string line;
+
+    while (next_line(p, end, line) && ! line.empty()) {
+      std::size_t fields[4];
+      std::size_t pos = 0;
+      for (int i = 0; i < 4; ++i) {
+        fields[i] = line.find(' ', pos);
+        if (fields[i] == std::string::npos)
+          corrupt("bad changed-path entry: " + line);
+        pos = fields[i] + 1;
+      }
+
+      RawChange change;
+      change.id = line.substr(0, fields[0]);
+
+      std::string action(line, fields[0] + 1, fields[1] - fields[0] - 1);
+      std::size_t dash = action.find('-');
+      change.kind = File::Node::KIND_NONE;
+      if (dash != std::string::npos) {
+        std::string kind(action, dash + 1);
+        if (kind == "file")
+          change.kind = File::Node::KIND_FILE;
+        else if (kind == "dir")
+          change.kind = File::Node::KIND_DIR;
+        action.erase(dash);
+      }
+
+      bool reset = false;
+      if (action == "add")
+        change.action = File::Node::ACTION_ADD;
+      else if (action == "delete")
+        change.action = File::Node::ACTION_DELETE;
+      else if (action == "modify")
+        change.action = File::Node::ACTION_CHANGE;
+      else if (action == "replace")
+        change.action = File::Node::ACTION_REPLACE;
+      else if (action == "reset")
+        reset = true;
+      else
+        corrupt("unknown change action: " + action);
+
+      change.text_mod = line.compare(fields[1] + 1, fields[2] - fields[1] - 1,
+                                     "true") == 0;
+      change.prop_mod = line.compare(fields[2] + 1, fields[3] - fields[2] - 1,
+                                     "true") == 0;
+
+      // Format 7 added a mergeinfo-mod flag before the path, which
+      // always begins with a slash
+      std::string path(line, fields[3] + 1);
+      if (! path.empty() && path[0] != '/') {
+        std::size_t space = path.find(' ');
+        if (space == std::string::npos)
+          corrupt("bad changed-path entry: " + line);
+        path.erase(0, space + 1);
+      }
+      if (path.empty() || path[0] != '/')
+        corrupt("bad changed-path entry: " + line);
+      change.path = path;
+
+      if (! next_line(p, end, line))
+        corrupt("unterminated changed-path list");
+      change.copy_from_rev = -1;
+      if (! line.empty()) {
+        std::size_t space = line.find(' ');
+        if (space == std::string::npos)
+          corrupt("bad copy source: " + line);
+        change.copy_from_rev  = to_number(line.substr(0, space));
+        change.copy_from_path = line.substr(space + 1);
+        if (! change.copy_from_path.empty() &&
+            change.copy_from_path[0] == '/')
+          change.copy_from_path.erase(0, 1);
+      }
+
+      if (reset)
+        continue;
+
+      // Deleting or replacing a directory does away with what was
+      // recorded beneath it
+      if (change.action == File::Node::ACTION_DELETE ||
+          change.action == File::Node::ACTION_REPLACE) {
+        std::map<std::string, RawChange>::iterator i =
+          folded.lower_bound(change.path + "/");
+        while (i != folded.end() && is_within(i->first, change.path))
+          folded.erase(i++);
+      }
+
+      std::map<std::string, RawChange>::iterator i = folded.find(path);
+      if (i == folded.end()) {
+        folded.insert(std::make_pair(path, change));
+        continue;
+      }
+
+      RawChange& prior(i->second);
+      switch (change.action) {
+      case File::Node::ACTION_DELETE:
+        if (prior.action == File::Node::ACTION_ADD)
+          folded.erase(i);
+        else
+          prior = change;
+        break;
+
+      case File::Node::ACTION_ADD:
+      case File::Node::ACTION_REPLACE:
+        if (prior.action == File::Node::ACTION_DELETE)
+          change.action = File::Node::ACTION_REPLACE;
+        prior = change;
+        break;
+
+      default:
+        prior.id        = change.id;
+        prior.text_mod |= change.text_mod;
+        prior.prop_mod |= change.prop_mod;
+        if (prior.kind == File::Node::KIND_NONE)
+          prior.kind = change.kind;
+        break;
+      }
+    }
+
+    for (std::map<std::string, RawChange>::const_iterator i = folded.begin();
+         i != folded.end();
+         ++i)
+      changes.push_back(i->second);
+
+    std::sort(changes.begin(), changes.end(),
+              [](const RawChange& a, const RawChange& b) {
+                return path_less(a.path, b.path);
+              });
+  }
+
+  /**
+   * The revision and item number of a node-revision ID, which has the
+   * form "<node>.<copy>.r<rev>/<item>".
+   */
+  void parse_node_id(const std::string& id, int& rev, uint64_t& number)
+  {
+    std::size_t r     = id.rfind(".r");
+    std::size_t slash = id.rfind('/');
+    if (r == std::string::npos || slash == std::string::npos || slash < r)
+      corrupt("bad node-revision ID: " + id);
+    rev    = static_cast<int>(to_number(id.substr(r + 2, slash - r - 2)));
+    number = to_number(id.substr(slash + 1));
+  }
+}
+
+FsfsRepository::MappedFile::MappedFile(const filesystem::path& path,
+                                       bool logical)
+  : data(nullptr), len(0), first_rev(-1), page_size(0)
+{
+  int fd = ::open(path.string().c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::logic_error(std::string("Could not open ") + path.string());
+
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::logic_error(std::string("Could not stat ") + path.string());
+  }
+  len = static_cast<std::size_t>(st.st_size);
+
+  if (len > 0) {
+    void * addr = ::mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      ::close(fd);
+      throw std::logic_error(std::string("Could not map ") + path.string());
+    }
+    data = static_cast<const char *>(addr);
+  }
+  ::close(fd);
+
+  if (! logical)
+    return;
+
+  // The last byte gives the length of the footer before it, which says
+  // where the log-to-phys and phys-to-log indexes begin
+  if (len < 2)
+    corrupt(path.string());
+  std::size_t footer_len = static_cast<unsigned char>(data[len - 1]);
+  if (footer_len > len - 1)
+    corrupt(path.string());
+
+  std::vector<std::string> footer =
+    split(std::string(data + len - 1 - footer_len, footer_len));
+  if (footer.size() < 3)
+    corrupt(path.string());
+  uint64_t l2p_offset = to_number(footer[0]);
+  uint64_t p2l_offset = to_number(footer[2]);
+  if (l2p_offset > p2l_offset || p2l_offset > len)
+    corrupt(path.string());
+
+  const char * p   = data + l2p_offset;
+  const char * end = data + p2l_offset;
+
+  static const char header[] = "L2P-INDEX\n";
+  if (static_cast<std::size_t>(end - p) >= sizeof(header) - 1 &&
+      std::memcmp(p, header, sizeof(header) - 1) == 0)
+    p += sizeof(header) - 1;
+
+  first_rev                = static_cast<int>(read_packed(p, end));
+  page_size                = read_packed(p, end);
+  uint64_t rev_count       = read_packed(p, end);
+  uint64_t page_count      = read_packed(p, end);
+  if (page_size == 0 || rev_count > len || page_count > len)
+    corrupt(path.string());
+
+  rev_pages.push_back(0);
+  for (uint64_t i = 0; i < rev_count; ++i)
+    rev_pages.push_back(rev_pages.back() + read_packed(p, end));
+  if (rev_pages.back() != page_count)
+    corrupt(path.string());
+
+  std::vector<uint64_t> sizes;
+  for (uint64_t i = 0; i < page_count; ++i) {
+    Page page;
+    sizes.push_back(read_packed(p, end));
+    page.entries = static_cast<uint32_t>(read_packed(p, end));
+    pages.push_back(page);
+  }
+
+  uint64_t offset = p - data;
+  for (uint64_t i = 0; i < page_count; ++i) {
+    pages[i].offset = offset;
+    offset += sizes[i];
+  }
+  if (offset > p2l_offset)
+    corrupt(path.string());
+}
+
+FsfsRepository::MappedFile::~MappedFile()
+{
+  if (data)
+    ::munmap(const_cast<char *>(data), len);
+}
+
+FsfsRepository::FsfsRepository(const filesystem::path& repository,
+                               std::size_t _threads)
+  : db(repository / "db"), format(0), shard_size(0), logical(false),
+    youngest(0), min_unpacked(0), threads(_threads), next_rev(0),
+    next_claim(0), buffered(0), stopping(false)
+{
+  if (filesystem::is_regular_file(db / "fs-type")) {
+    std::vector<std::string> fs_type = split(read_file(db / "fs-type"));
+    if (fs_type.empty() || fs_type[0] != "fsfs")
+      throw std::logic_error(std::string("Only FSFS repositories can be read: ") +
+                             repository.string());
+  }
+
+  std::string line;
+  std::string contents(read_file(db / "format"));
+  const char * p   = contents.data();
+  const char * end = p + contents.size();
+
+  if (next_line(p, end, line))
+    format = static_cast<int>(to_number(line));
+  if (format < 1 || format > 8)
+    throw std::logic_error(std::string("Unsupported FSFS format in ") +
+                           repository.string());
+
+  while (next_line(p, end, line)) {
+    std::vector<std::string> option(split(line));
+    if (option.size() == 3 && option[0] == "layout" &&
+        option[1] == "sharded")
+      shard_size = static_cast<int>(to_number(option[2]));
+    else if (option.size() == 2 && option[0] == "addressing")
+      logical = option[1] == "logical";
+  }
+
+  std::vector<std::string> current(split(read_file(db / "current")));
+  if (current.empty())
+    corrupt((db / "current").string());
+  youngest = static_cast<int>(to_number(current[0]));
+
+  if (format >= 4 && filesystem::is_regular_file(db / "min-unpacked-rev")) {
+    std::vector<std::string> unpacked
+      (split(read_file(db / "min-unpacked-rev")));
+    if (! unpacked.empty())
+      min_unpacked = static_cast<int>(to_number(unpacked[0]));
+  }
+
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+
+  start();
+}
+
+bool FsfsRepository::detect(const filesystem::path& repository)
+{
+  return (filesystem::is_regular_file(repository / "format") &&
+          filesystem::is_regular_file(repository / "db" / "format") &&
+          filesystem::is_regular_file(repository / "db" / "current"));
+}
+
+void FsfsRepository::restart(int rev)
+{
+  stop();
+
+  done.clear();
+  failures.clear();
+  buffered   = 0;
+  next_rev   = rev;
+  next_claim = rev;
+
+  start();
+}
+
+FsfsRevisionPtr FsfsRepository::next()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  if (next_rev > youngest)
+    return FsfsRevisionPtr();
+
+  int rev = next_rev;
+  ready.wait(guard, [&]() {
+      return done.count(rev) > 0 || failures.count(rev) > 0;
+    });
+
+  std::map<int, std::string>::iterator failure = failures.find(rev);
+  if (failure != failures.end())
+    throw std::logic_error(failure->second);
+
+  std::map<int, FsfsRevisionPtr>::iterator i = done.find(rev);
+  FsfsRevisionPtr revision(i->second);
+  done.erase(i);
+  buffered -= revision->bytes;
+  ++next_rev;
+
+  room.notify_all();
+  return revision;
+}
+
+void FsfsRepository::start()
+{
+  stopping = false;
+  for (std::size_t i = 0; i < threads; ++i)
+    workers.push_back(std::thread(&FsfsRepository::run, this));
+}
+
+void FsfsRepository::stop()
+{
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  room.notify_all();
+
+  for (std::size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+  workers.clear();
+}
+
+/**
+ * Each worker claims the next revision nobody has, as long as it is
+ * within WINDOW of the one the reader wants and the revisions waiting
+ * for the reader don't already take up MAX_BYTES.
+ */
+void FsfsRepository::run()
+{
+  for (;;) {
+    int rev;
+    {
+      std::unique_lock<std::mutex> guard(lock);
+      room.wait(guard, [&]() {
+          return (stopping || next_claim > youngest ||
+                  (next_claim < next_rev + WINDOW && buffered < MAX_BYTES));
+        });
+      if (stopping || next_claim > youngest)
+        return;
+      rev = next_claim++;
+    }
+
+    FsfsRevisionPtr revision;
+    std::string     failure;
+    try {
+      revision = read_revision(rev);
+    }
+    catch (const std::exception& err) {
+      failure = err.what();
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (revision) {
+        done[rev] = revision;
+        buffered += revision->bytes;
+      } else {
+        failures[rev] = failure;
+      }
+    }
+    ready.notify_all();
+  }
+}
+
+FsfsRevisionPtr FsfsRepository::read_revision(int rev)
+{
+  shared_ptr<FsfsRevision> revision(new FsfsRevision);
+  revision->rev = rev;
+
+  read_revprops(rev, *revision);
+
+  // With physical addressing, the revision ends with a line giving the
+  // offsets of its root node and its changed-path list.  With logical
+  // addressing, the changed-path list is always item 1.
+  const char * p;
+  const char * end;
+  file_ptr     file;
+  if (logical) {
+    file = item(rev, 1, p, end);
+  } else {
+    uint64_t begin, stop;
+    file = locate(rev, begin, stop);
+
+    const char * first = file->data + begin;
+    const char * last  = file->data + stop;
+    if (last - first < 2 || last[-1] != '\n')
+      corrupt("revision " + lexical_cast<std::string>(rev) +
+              " has no trailer");
+    const char * trailer = last - 1;
+    while (trailer > first && trailer[-1] != '\n')
+      --trailer;
+
+    std::vector<std::string> offsets(split(std::string(trailer, last)));
+    if (offsets.size() != 2)
+      corrupt("revision " + lexical_cast<std::string>(rev) +
+              " has a bad trailer");
+    uint64_t changes = to_number(offsets[1]);
+    if (changes > static_cast<uint64_t>(trailer - first))
+      corrupt("revision " + lexical_cast<std::string>(rev) +
+              " has a bad trailer");
+    p   = first + changes;
+    end = trailer;
+  }
+
+  std::vector<RawChange> changes;
+  parse_changes(p, end, changes);
+
+  for (std::vector<RawChange>::const_iterator i = changes.begin();
+       i != changes.end();
+       ++i) {
+    revision->changes.push_back(FsfsChange());
+    FsfsChange& change(revision->changes.back());
+
+    change.path           = i->path.substr(1);
+    change.action         = i->action;
+    change.copy_from_rev  = i->copy_from_rev;
+    change.copy_from_path = i->copy_from_path;
+
+    if (i->action == File::Node::ACTION_DELETE)
+      continue;
+
+    // The node-revision gives the kind, if the changed-path list did
+    // not, and the representations of its properties and text
+    int      node_rev;
+    uint64_t node_number;
+    parse_node_id(i->id, node_rev, node_number);
+
+    const char * q;
+    const char * q_end;
+    file_ptr node_file = item(node_rev, node_number, q, q_end);
+
+    hash_map    headers;
+    std::string line;
+    while (next_line(q, q_end, line) && ! line.empty()) {
+      std::size_t colon = line.find(": ");
+      if (colon != std::string::npos)
+        headers[line.substr(0, colon)] = line.substr(colon + 2);
+    }
+
+    change.kind = i->kind;
+    if (change.kind == File::Node::KIND_NONE) {
+      if (headers["type"] == "file")
+        change.kind = File::Node::KIND_FILE;
+      else if (headers["type"] == "dir")
+        change.kind = File::Node::KIND_DIR;
+      else
+        corrupt("node-revision " + i->id + " has no type");
+    }
+
+    // A dump without --deltas gives all properties and the full text
+    // of any node that is new or changed
+    bool fresh = ((i->action == File::Node::ACTION_ADD ||
+                   i->action == File::Node::ACTION_REPLACE) &&
+                  i->copy_from_rev == -1);
+
+    if (i->prop_mod || fresh) {
+      change.has_props = true;
+
+      hash_map::const_iterator props = headers.find("props");
+      if (props != headers.end()) {
+        read_rep(props->second, change.props);
+        if (! ends_with(change.props, "END\n"))
+          corrupt("node-revision " + i->id + " has bad properties");
+        change.props.resize(change.props.size() - 4);
+      }
+      change.props += "PROPS-END\n";
+    }
+
+    if (change.kind == File::Node::KIND_FILE && (i->text_mod || fresh)) {
+      change.has_text = true;
+
+      hash_map::const_iterator text = headers.find("text");
+      if (text != headers.end())
+        read_rep(text->second, change.text, &change.md5, &change.sha1);
+    }
+
+    revision->bytes += change.props.size() + change.text.size();
+  }
+
+  return revision;
+}
+
+FsfsRepository::file_ptr
+FsfsRepository::open_file(const filesystem::path& path)
+{
+  static const std::size_t MAX_FILES = 32;
+
+  std::string name(path.string());
+
+  std::lock_guard<std::mutex> guard(files_lock);
+  for (std::list<std::pair<std::string, file_ptr> >::iterator i =
+         files.begin();
+       i != files.end();
+       ++i)
+    if (i->first == name) {
+      files.splice(files.begin(), files, i);
+      return i->second;
+    }
+
+  file_ptr file(new MappedFile(path, logical));
+  files.push_front(std::make_pair(name, file));
+  if (files.size() > MAX_FILES)
+    files.pop_back();
+  return file;
+}
+
+/**
+ * The file holding revision `rev', and where the revision lies in it.
+ * A packed shard's manifest gives the offset of each of its revisions
+ * when addressing is physical; with logical addressing, item offsets
+ * are relative to the whole pack file.
+ */
+FsfsRepository::file_ptr
+FsfsRepository::locate(int rev, uint64_t& begin, uint64_t& end)
+{
+  if (rev < 0 || rev > youngest)
+    corrupt("no revision " + lexical_cast<std::string>(rev));
+
+  if (shard_size == 0 || rev >= min_unpacked) {
+    file_ptr file(open_file(shard_path("revs", rev)));
+    begin = 0;
+    end   = file->len;
+    return file;
+  }
+
+  int              shard = rev / shard_size;
+  filesystem::path pack(db / "revs" /
+                        (lexical_cast<std::string>(shard) + ".pack"));
+  file_ptr         file(open_file(pack / "pack"));
+
+  begin = 0;
+  end   = file->len;
+  if (logical)
+    return file;
+
+  std::vector<uint64_t> manifest;
+  {
+    std::lock_guard<std::mutex> guard(files_lock);
+    std::map<int, std::vector<uint64_t> >::iterator i = manifests.find(shard);
+    if (i != manifests.end())
+      manifest = i->second;
+  }
+  if (manifest.empty()) {
+    std::vector<std::string> offsets(split(read_file(pack / "manifest")));
+    for (std::size_t i = 0; i < offsets.size(); ++i)
+      manifest.push_back(to_number(offsets[i]));
+
+    std::lock_guard<std::mutex> guard(files_lock);
+    manifests[shard] = manifest;
+  }
+
+  std::size_t index = rev - shard * shard_size;
+  if (index >= manifest.size())
+    corrupt((pack / "manifest").string());
+  begin = manifest[index];
+  if (index + 1 < manifest.size())
+    end = manifest[index + 1];
+  if (begin > end || end > file->len)
+    corrupt((pack / "manifest").string());
+  return file;
+}
+
+/**
+ * Find item `number' of revision `rev', setting `p' to its start and
+ * `end' to the end of the data it may run up to.  The file returned
+ * must be kept for as long as they are used.
+ */
+FsfsRepository::file_ptr
+FsfsRepository::item(int rev, uint64_t number, const char *& p,
+                     const char *& end)
+{
+  uint64_t begin, stop;
+  file_ptr file(locate(rev, begin, stop));
+
+  uint64_t offset = logical ? lookup(*file, rev, number) : begin + number;
+  if (offset >= stop)
+    corrupt("item " + lexical_cast<std::string>(number) + " of revision " +
+            lexical_cast<std::string>(rev) + " lies outside it");
+
+  p   = file->data + offset;
+  end = file->data + stop;
+  return file;
+}
+
+/**
+ * Look an item's offset up in the log-to-phys index.  Each page lists
+ * the offsets of a run of item numbers, as differences from the one
+ * before, with the sign in the lowest bit; offsets are stored plus one,
+ * so that zero marks an unused item.
+ */
+uint64_t FsfsRepository::lookup(const MappedFile& file, int rev,
+                                uint64_t number) const
+{
+  std::string where("item " + lexical_cast<std::string>(number) +
+                    " of revision " + lexical_cast<std::string>(rev));
+
+  if (rev < file.first_rev ||
+      static_cast<std::size_t>(rev - file.first_rev) + 1 >=
+      file.rev_pages.size())
+    corrupt(where + " is not indexed");
+
+  std::size_t r    = rev - file.first_rev;
+  uint64_t    page = file.rev_pages[r] + number / file.page_size;
+  if (page >= file.rev_pages[r + 1])
+    corrupt(where + " is not indexed");
+
+  const MappedFile::Page& entries(file.pages[page]);
+  uint64_t slot = number % file.page_size;
+  if (slot >= entries.entries)
+    corrupt(where + " is not indexed");
+
+  const char * p    = file.data + entries.offset;
+  const char * end  = file.data + file.len;
+  int64_t      last = 0;
+  for (uint64_t i = 0; i <= slot; ++i) {
+    uint64_t value = read_packed(p, end);
+    last += (value & 1) ? -static_cast<int64_t>(value >> 1) - 1
+                        : static_cast<int64_t>(value >> 1);
+  }
+  if (last <= 0)
+    corrupt(where + " is unused");
+  return static_cast<uint64_t>(last - 1);
+}
+
+/**
+ * Read the properties of revision `rev', either from their own file or
+ * from the pack file the shard's manifest names for it.  A pack file
+ * is compressed, and begins with the first revision in it, the count
+ * of revisions and the size of each, one to a line, then a blank line.
+ */
+void FsfsRepository::read_revprops(int rev, FsfsRevision& revision)
+{
+  std::string      contents;
+  filesystem::path path(shard_path("revprops", rev));
+
+  if (rev == 0 || shard_size == 0 || filesystem::is_regular_file(path)) {
+    contents = read_file(path);
+  } else {
+    int              shard = rev / shard_size;
+    filesystem::path pack(db / "revprops" /
+                          (lexical_cast<std::string>(shard) + ".pack"));
+
+    std::vector<std::string> names(split(read_file(pack / "manifest")));
+    std::size_t index = rev - shard * shard_size;
+    if (index >= names.size())
+      corrupt((pack / "manifest").string());
+
+    std::string packed(read_file(pack / names[index]));
+    std::string data;
+    svn_decompress(packed.data(), packed.size(), data);
+
+    const char * p   = data.data();
+    const char * end = p + data.size();
+    std::string  line;
+
+    std::vector<uint64_t> sizes;
+    int first = -1;
+    if (next_line(p, end, line))
+      first = static_cast<int>(to_number(line));
+    if (next_line(p, end, line))
+      sizes.resize(to_number(line));
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+      if (! next_line(p, end, line))
+        corrupt((pack / names[index]).string());
+      sizes[i] = to_number(line);
+    }
+    if (! next_line(p, end, line) || ! line.empty() ||
+        rev < first || static_cast<std::size_t>(rev - first) >= sizes.size())
+      corrupt((pack / names[index]).string());
+
+    for (int i = first; i < rev; ++i)
+      p += sizes[i - first];
+    if (p > end || static_cast<uint64_t>(end - p) < sizes[rev - first])
+      corrupt((pack / names[index]).string());
+    contents.assign(p, sizes[rev - first]);
+  }
+
+  hash_map props;
+  parse_hash(contents.data(), contents.data() + contents.size(), props);
+
+  hash_map::const_iterator i = props.find("svn:author");
+  if (i != props.end())
+    revision.author = i->second;
+  i = props.find("svn:date");
+  if (i != props.end())
+    revision.date = i->second;
+  i = props.find("svn:log");
+  if (i != props.end())
+    revision.log = i->second;
+}
+
+/**
+ * Expand the representation a node-revision's "text" or "props" line
+ * describes:
+ *
+ *   <rev> <item> <size> <expanded-size> <md5> [<sha1> <uniquifier>]
+ */
+void FsfsRepository::read_rep(const std::string& line, std::string& text,
+                              std::string * md5, std::string * sha1)
+{
+  std::vector<std::string> fields(split(line));
+  if (fields.size() < 5)
+    corrupt("bad representation: " + line);
+
+  // A representation still in a transaction has no revision of its own
+  if (fields[0] == "-1")
+    corrupt("representation outside of any revision: " + line);
+
+  expand(static_cast<int>(to_number(fields[0])), to_number(fields[1]),
+         to_number(fields[2]), text);
+
+  if (md5)
+    *md5 = fields[4];
+  if (sha1 && fields.size() > 5 && fields[5].size() == 40)
+    *sha1 = fields[5];
+}
+
+/**
+ * Expand the representation at item `number' of revision `rev', which
+ * is `size' bytes long after its header.  That header says "PLAIN",
+ * or "DELTA" followed by where to find the representation the delta is
+ * against, if it is against one.
+ */
+void FsfsRepository::expand(int rev, uint64_t number, uint64_t size,
+                            std::string& text)
+{
+  std::string key(lexical_cast<std::string>(rev) + "/" +
+                  lexical_cast<std::string>(number));
+  {
+    std::lock_guard<std::mutex> guard(texts_lock);
+    TextCache::text_ptr cached(texts.find(key));
+    if (cached) {
+      text = *cached;
+      return;
+    }
+  }
+
+  const char * p;
+  const char * end;
+  file_ptr     file(item(rev, number, p, end));
+
+  std::string header;
+  if (! next_line(p, end, header) ||
+      static_cast<uint64_t>(end - p) < size)
+    corrupt("representation " + key + " lies outside its revision");
+
+  if (header == "PLAIN") {
+    text.assign(p, size);
+  }
+  else if (starts_with(header, "DELTA")) {
+    std::vector<std::string> base(split(header));
+    std::string source;
+    if (base.size() == 4)
+      expand(static_cast<int>(to_number(base[1])), to_number(base[2]),
+             to_number(base[3]), source);
+    else if (base.size() != 1)
+      corrupt("representation " + key + " has a bad header");
+
+    text.clear();
+    apply_svndiff(p, size, source.data(), source.size(), text);
+  }
+  else {
+    corrupt("representation " + key + " has a bad header");
+  }
+
+  std::lock_guard<std::mutex> guard(texts_lock);
+  texts.insert(key, TextCache::text_ptr(new std::string(text)));
+}
+
+filesystem::path FsfsRepository::shard_path(const char * dir, int rev) const
+{
+  std::string name(lexical_cast<std::string>(rev));
+  if (shard_size == 0)
+    return db / dir / name;
+  return db / dir / lexical_cast<std::string>(rev / shard_size) / name;
+}
+
+} // namespace SvnDump
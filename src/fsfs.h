@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _FSFS_H
+#define _FSFS_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  // A node of a revision read from an FSFS repository, as a dump made
+  // without --deltas would have it
+  struct FsfsChange
+  {
+    std::string        path;
+    File::Node::Kind   kind;
+    File::Node::Action action;
+    int                copy_from_rev;   // -1 if not a copy
+    std::string        copy_from_path;
+
+    bool        has_props;
+    std::string props;          // ending with "PROPS-END", as in a dump
+    bool        has_text;
+    std::string text;
+    std::string md5;
+    std::string sha1;
+
+    FsfsChange() : kind(File::Node::KIND_NONE),
+                   action(File::Node::ACTION_NONE), copy_from_rev(-1),
+                   has_props(false), has_text(false) {}
+  };
+
+  struct FsfsRevision
+  {
+    int                     rev;
+    optional<std::string>   author;
+    optional<std::string>   date;   // as svn:date has it
+    optional<std::string>   log;
+    std::vector<FsfsChange> changes;
+    std::size_t             bytes;  // of texts and properties
+
+    FsfsRevision() : rev(-1), bytes(0) {}
+  };
+
+  typedef shared_ptr<const FsfsRevision> FsfsRevisionPtr;
+
+  /**
+   * Reads the revisions of a local FSFS repository straight from its
+   * revision and revision property files, so that no dump need be made
+   * of it.  Representations are expanded here, applying their chain of
+   * deltas, and the changed paths of each revision are put in the order
+   * "svnadmin dump" would give them.
+   *
+   * Revisions are read ahead of the reader on a pool of threads, each
+   * taking the next revision not yet claimed, so that the reads spread
+   * over the repository's shards.  They are handed out in order.
+   *
+   * Both physical and logical addressing are understood, as are packed
+   * shards.  Representations compressed with LZ4 (svndiff2) are not.
+   */
+  class FsfsRepository : public noncopyable
+  {
+    static const int         WINDOW    = 256;       // revisions read ahead
+    static const std::size_t MAX_BYTES = 64 << 20;  // and their size
+
+    // A revision or pack file, mapped into memory.  With logical
+    // addressing, the page tables of its log-to-phys index are kept.
+    struct MappedFile : public noncopyable {
+      struct Page {
+        uint64_t offset;
+        uint32_t entries;
+      };
+
+      const char *          data;
+      std::size_t           len;
+      int                   first_rev;
+      uint64_t              page_size;
+      std::vector<uint64_t> rev_pages;  // index of each revision's first page
+      std::vector<Page>     pages;
+
+      MappedFile(const filesystem::path& path, bool logical);
+      ~MappedFile();
+    };
+
+    typedef shared_ptr<const MappedFile> file_ptr;
+
+    filesystem::path db;
+    int              format;
+    int              shard_size;        // 0 if the layout is linear
+    bool             logical;
+    int              youngest;
+    int              min_unpacked;      // revisions before this are packed
+
+    // Recently used files, most recent first, and the manifests of
+    // packed shards
+    std::mutex                                   files_lock;
+    std::list<std::pair<std::string, file_ptr> > files;
+    std::map<int, std::vector<uint64_t> >        manifests;
+
+    // Full texts of recently expanded representations
+    std::mutex texts_lock;
+    TextCache  texts;
+
+    std::size_t                    threads;
+    std::vector<std::thread>       workers;
+    std::mutex                     lock;
+    std::condition_variable        ready;       // a revision was read
+    std::condition_variable        room;        // one was handed out
+    std::map<int, FsfsRevisionPtr> done;
+    std::map<int, std::string>     failures;
+    int                            next_rev;    // the next to hand out
+    int                            next_claim;  // the next to be read
+    std::size_t                    buffered;
+    bool                           stopping;
+
+  public:
+    // A `threads' count of zero uses one thread per processor
+    FsfsRepository(const filesystem::path& repository,
+                   std::size_t _threads = 0);
+    ~FsfsRepository() {
+      stop();
+    }
+
+    static bool detect(const filesystem::path& repository);
+
+    int get_youngest() const {
+      return youngest;
+    }
+
+    // Read from revision `rev' on
+    void restart(int rev);
+
+    // The next revision, or nullptr after the youngest
+    FsfsRevisionPtr next();
+
+  private:
+    void start();
+    void stop();
+    void run();
+
+    FsfsRevisionPtr read_revision(int rev);
+
+    file_ptr open_file(const filesystem::path& path);
+    file_ptr locate(int rev, uint64_t& begin, uint64_t& end);
+    file_ptr item(int rev, uint64_t number, const char *& p,
+                  const char *& end);
+    uint64_t lookup(const MappedFile& file, int rev, uint64_t number) const;
+
+    void read_revprops(int rev, FsfsRevision& revision);
+    void read_rep(const std::string& line, std::string& text,
+                  std::string * md5 = nullptr, std::string * sha1 = nullptr);
+    void expand(int rev, uint64_t number, uint64_t size, std::string& text);
+
+    filesystem::path shard_path(const char * dir, int rev) const;
+  };
+}
+
+#endif // _FSFS_H
@@ -129,7 +129,7 @@ bool Tree::do_update(filesystem::path::iterator segment,
 {
   assert(check_size(*repository, *this));
 
-  std::string entry_name = (*segment).string();
+  Name entry_name((*segment).string());
   assert(! entry_name.empty());
 
   entries_map::iterator i = entries.find(entry_name);
@@ -202,7 +202,10 @@ void Tree::do_remove(filesystem::path::iterator segment,
 {
   assert(check_size(*repository, *this));
 
-  std::string entry_name = (*segment).string();
+  // A name never interned cannot be the name of any entry
+  Name entry_name;
+  if (! Name::find((*segment).string(), entry_name))
+    return;
 
   entries_map::iterator i   = entries.find(entry_name);
   entries_map::iterator del = entries.end();
@@ -480,7 +483,7 @@ void Branch::update(CommitPtr ptr, std::string refname)
              commit->get_oid(), 1));
 }
 
-BlobPtr Repository::create_blob(const std::string& blob_name, const char * data,
+BlobPtr Repository::create_blob(const Name& blob_name, const char * data,
                                 std::size_t len, unsigned int attributes)
 {
   git_oid blob_oid;
@@ -491,7 +494,22 @@ BlobPtr Repository::create_blob(const std::string& blob_name, const char * data,
   return blob;
 }
 
-TreePtr Repository::create_tree(const std::string& name,
+/**
+ * Read back the contents of a blob already written to the repository.
+ */
+bool Repository::read_blob(ObjectPtr obj, std::string& data)
+{
+  git_blob * blob;
+  if (! obj->is_blob() || git_blob_lookup(&blob, *this, *obj) != 0)
+    return false;
+
+  data.assign(static_cast<const char *>(git_blob_rawcontent(blob)),
+              static_cast<std::size_t>(git_blob_rawsize(blob)));
+  git_blob_free(blob);
+  return true;
+}
+
+TreePtr Repository::create_tree(const Name& name,
                                 unsigned int attributes)
 {
   Tree * tree = new Tree(this, nullptr, name, attributes);
@@ -590,15 +608,8 @@ BranchPtr Repository::find_branch_by_name(const std::string& name,
 BranchPtr Repository::find_branch_by_path(const filesystem::path& pathname,
                                           BranchPtr default_obj)
 {
-  if (! branches_by_path.empty()) {
-    for (filesystem::path dirname(pathname);
-         ! dirname.empty();
-         dirname = dirname.parent_path()) {
-      branches_path_map::iterator i = branches_by_path.find(dirname);
-      if (i != branches_by_path.end())
-        return (*i).second;
-    }
-  }
+  if (Branch * branch = lookup_branch_by_path(pathname))
+    return branch;
 
   if (default_obj) {
     std::pair<branches_path_map::iterator, bool> result =
@@ -615,6 +626,22 @@ BranchPtr Repository::find_branch_by_path(const filesystem::path& pathname,
   return nullptr;
 }
 
+/**
+ * Like find_branch_by_path, but neither logs nor touches any reference
+ * counts, so that it may be called from several threads at once.
+ */
+Branch * Repository::lookup_branch_by_path(const filesystem::path& pathname) const
+{
+  for (filesystem::path dirname(pathname);
+       ! dirname.empty();
+       dirname = dirname.parent_path()) {
+    branches_path_map::const_iterator i = branches_by_path.find(dirname);
+    if (i != branches_by_path.end())
+      return (*i).second.get();
+  }
+  return nullptr;
+}
+
 void Repository::delete_branch(BranchPtr branch, int related_revision)
 {
   if (log.debug_mode()) {
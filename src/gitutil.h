@@ -34,6 +34,7 @@
 #define _GITUTIL_H
 
 #include "system.hpp"
+#include "intern.h"
 
 using namespace boost;
 
@@ -85,12 +86,12 @@ namespace Git
     }
 
   public:
-    std::string  name;
+    Name         name;
     unsigned int attributes;
     bool         written;
 
     Object(RepositoryPtr _repository, const git_oid * _oid,
-           const std::string& _name = "", unsigned int _attributes = 0)
+           const Name& _name = Name(), unsigned int _attributes = 0)
       : repository(_repository), refc(0), name(_name),
         attributes(_attributes), written(_oid != nullptr) {
       if (_oid != nullptr)
@@ -126,7 +127,7 @@ namespace Git
       return written;
     }
 
-    virtual ObjectPtr copy_to_name(const std::string& to_name,
+    virtual ObjectPtr copy_to_name(const Name& to_name,
                                    bool always_copy = false) = 0;
 
     virtual void write() {}
@@ -162,10 +163,10 @@ namespace Git
   {
   public:
     Blob(RepositoryPtr repository, const git_oid * _oid,
-         const std::string& name, unsigned int attributes = 0100644)
+         const Name& name, unsigned int attributes = 0100644)
       : Object(repository, _oid, name, attributes) {}
 
-    virtual ObjectPtr copy_to_name(const std::string& to_name,
+    virtual ObjectPtr copy_to_name(const Name& to_name,
                                    bool always_copy = false) {
       if (name == to_name && ! always_copy)
         return this;
@@ -197,8 +198,8 @@ namespace Git
     friend bool check_size(const Repository& repository, const Tree& tree);
 
   protected:
-    typedef std::map<std::string, ObjectPtr>  entries_map;
-    typedef std::pair<std::string, ObjectPtr> entries_pair;
+    typedef std::map<Name, ObjectPtr>  entries_map;
+    typedef std::pair<Name, ObjectPtr> entries_pair;
 
     entries_map entries;
     bool        modified;
@@ -206,7 +207,10 @@ namespace Git
     ObjectPtr do_lookup(filesystem::path::iterator segment,
                         filesystem::path::iterator end)
     {
-      std::string name = (*segment).string();
+      // A name never interned cannot be the name of any entry
+      Name name;
+      if (! Name::find((*segment).string(), name))
+        return nullptr;
 
       entries_map::iterator i = entries.find(name);
       if (i == entries.end())
@@ -230,7 +234,7 @@ namespace Git
 
   public:
     Tree(RepositoryPtr repository, const git_oid * _oid,
-         const std::string& name, unsigned int attributes = 0040000)
+         const Name& name, unsigned int attributes = 0040000)
       : Object(repository, _oid, name, attributes), builder(nullptr),
         modified(false) {}
 
@@ -260,7 +264,7 @@ namespace Git
     virtual TreePtr copy() {
       return new Tree(*this);
     }
-    virtual ObjectPtr copy_to_name(const std::string& to_name, bool = false) {
+    virtual ObjectPtr copy_to_name(const Name& to_name, bool = false) {
       TreePtr new_tree(copy());
       new_tree->name = to_name;
       return new_tree;
@@ -279,7 +283,7 @@ namespace Git
         assert(obj->is_tree());
         TreePtr subtree = dynamic_cast<Tree *>(obj.get());
         for (auto entry : subtree->entries)
-          update(entry.first, entry.second);
+          update(entry.first.str(), entry.second);
       } else {
         do_update(pathname.begin(), pathname.end(), obj);
       }
@@ -332,7 +336,7 @@ namespace Git
     shared_ptr<git_signature> signature;
 
     Commit(RepositoryPtr repo, const git_oid * _oid, CommitPtr _parent = nullptr,
-           const std::string& name = "", unsigned int attributes = 0040000)
+           const Name& name = Name(), unsigned int attributes = 0040000)
       : Object(repo, _oid, name, attributes), parent(_parent),
         new_branch(false) {}
 
@@ -355,7 +359,7 @@ namespace Git
       tree = _tree;
     }
 
-    virtual ObjectPtr copy_to_name(const std::string& to_name, bool = false) {
+    virtual ObjectPtr copy_to_name(const Name& to_name, bool = false) {
       CommitPtr new_commit(clone(true));
       new_commit->name = to_name;
       return new_commit;
@@ -548,11 +552,12 @@ namespace Git
       return repo;
     }
 
-    BlobPtr   create_blob(const std::string& name,
+    BlobPtr   create_blob(const Name& name,
                           const char * data, std::size_t len,
                           unsigned int attributes = 0100644);
+    bool      read_blob(ObjectPtr blob, std::string& data);
 
-    TreePtr   create_tree(const std::string& name = "",
+    TreePtr   create_tree(const Name& name = Name(),
                           unsigned int attributes = 040000);
 
     CommitPtr create_commit(CommitPtr parent = nullptr);
@@ -561,6 +566,7 @@ namespace Git
                                   BranchPtr default_obj = nullptr);
     BranchPtr find_branch_by_path(const filesystem::path& name,
                                   BranchPtr default_obj = nullptr);
+    Branch *  lookup_branch_by_path(const filesystem::path& name) const;
     void      delete_branch(BranchPtr branch, int related_revision);
     bool      write(int related_revision);
     void      write_branches();
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "intern.h"
+
+namespace Git {
+
+namespace {
+  // Elements of an unordered_set never move, so the addresses handed
+  // out remain valid as the table grows.
+  struct NameTable {
+    std::unordered_set<std::string> names;
+    std::mutex                      lock;
+  };
+
+  NameTable& name_table()
+  {
+    static NameTable table;
+    return table;
+  }
+}
+
+const std::string * Name::intern(const std::string& text)
+{
+  NameTable& table(name_table());
+  std::lock_guard<std::mutex> guard(table.lock);
+  return &*table.names.insert(text).first;
+}
+
+const std::string * Name::empty_name()
+{
+  static const std::string * const empty = intern(std::string());
+  return empty;
+}
+
+bool Name::find(const std::string& text, Name& name)
+{
+  NameTable& table(name_table());
+  std::lock_guard<std::mutex> guard(table.lock);
+  std::unordered_set<std::string>::const_iterator i = table.names.find(text);
+  if (i == table.names.end())
+    return false;
+  name = Name(&*i);
+  return true;
+}
+
+} // namespace Git
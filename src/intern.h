@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _INTERN_H
+#define _INTERN_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace Git
+{
+  /**
+   * An interned string, used for the names of objects and of the
+   * entries in trees.  Every distinct name is stored once for the life
+   * of the program, however many trees and revisions refer to it, and
+   * two names are equal exactly when they share the same storage.
+   * Names still order by their text, so that trees list their entries
+   * as they did before.
+   */
+  class Name
+  {
+    const std::string * text_ptr;
+
+    explicit Name(const std::string * _text) : text_ptr(_text) {}
+
+    static const std::string * intern(const std::string& text);
+    static const std::string * empty_name();
+
+  public:
+    Name() : text_ptr(empty_name()) {}
+    Name(const std::string& text) : text_ptr(intern(text)) {}
+    Name(const char * text) : text_ptr(intern(text)) {}
+
+    // Find `text' without interning it, for lookups which would only
+    // fail if it has never been seen.
+    static bool find(const std::string& text, Name& name);
+
+    const std::string& str() const {
+      return *text_ptr;
+    }
+    operator const std::string&() const {
+      return *text_ptr;
+    }
+    const char * c_str() const {
+      return text_ptr->c_str();
+    }
+    bool empty() const {
+      return text_ptr->empty();
+    }
+
+    bool operator==(const Name& other) const {
+      return text_ptr == other.text_ptr;
+    }
+    bool operator!=(const Name& other) const {
+      return text_ptr != other.text_ptr;
+    }
+    bool operator<(const Name& other) const {
+      return text_ptr != other.text_ptr && *text_ptr < *other.text_ptr;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const Name& name) {
+      return out << *name.text_ptr;
+    }
+
+#if defined(HAVE_BOOST_SERIALIZATION)
+  private:
+    /** Serialization. */
+
+    friend class boost::serialization::access;
+
+    template<class Archive>
+    void save(Archive& ar, const unsigned int /* version */) const {
+      std::string text(*text_ptr);
+      ar & text;
+    }
+    template<class Archive>
+    void load(Archive& ar, const unsigned int /* version */) {
+      std::string text;
+      ar & text;
+      text_ptr = intern(text);
+    }
+    BOOST_SERIALIZATION_SPLIT_MEMBER()
+#endif // HAVE_BOOST_SERIALIZATION
+  };
+
+  inline std::string operator+(const std::string& left, const Name& right) {
+    return left + right.str();
+  }
+  inline std::string operator+(const Name& left, const std::string& right) {
+    return left.str() + right;
+  }
+}
+
+#endif // _INTERN_H
@@ -31,17 +31,189 @@
  */
 
 #include "converter.h"
+#include "archive.h"
 #include "branches.h"
+#include "dumpfilter.h"
+#include "pathfilter.h"
+#include "prescan.h"
+#include "readahead.h"
+#include "verify.h"
 
 namespace {
+  /**
+   * Read `dump' in up to `jobs' ranges of revisions at once, each on its
+   * own thread with its own SvnDump::File, filling in one `Chunk' per
+   * range with `scan'.  When all are done, `merge' is called with each
+   * chunk in revision order.  Returns false, having merged nothing, if
+   * the dump could not be split or the ranges did not join up; callers
+   * should then read the dump in the usual way.
+   */
+  template <typename Chunk, typename Scan, typename Merge>
+  bool scan_chunks(SvnDump::File& dump, const filesystem::path& pathname,
+                   bool mapped, int jobs, Scan scan, Merge merge)
+  {
+    if (jobs < 2)
+      return false;
+
+    std::vector<uint64_t> boundaries(dump.split(jobs));
+    std::size_t           count = boundaries.size();
+    if (count < 2)
+      return false;
+
+    std::vector<Chunk>       chunks(count);
+    std::vector<uint64_t>    stops(count, 0);
+    std::vector<std::string> failures(count);
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < count; ++i)
+      threads.push_back(std::thread([&, i]() {
+        try {
+          SvnDump::File part(pathname, mapped, dump.get_cache_policy());
+          part.set_range(boundaries[i],
+                         i + 1 < count ? boundaries[i + 1] : UINT64_MAX);
+          scan(part, chunks[i]);
+          stops[i] = part.tell();
+        }
+        catch (const std::exception& err) {
+          failures[i] = err.what();
+        }
+      }));
+
+    for (std::size_t i = 0; i < count; ++i)
+      threads[i].join();
+
+    for (std::size_t i = 0; i < count; ++i)
+      if (! failures[i].empty())
+        throw std::logic_error(failures[i]);
+
+    // A range boundary found by searching may have been inside a text
+    // body, in which case the range before it stops somewhere else.
+    for (std::size_t i = 1; i < count; ++i)
+      if (stops[i - 1] != boundaries[i])
+        return false;
+
+    for (std::size_t i = 0; i < count; ++i)
+      merge(chunks[i]);
+    return true;
+  }
+
+  inline bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  /**
+   * Compare file names so that runs of digits are ordered by their
+   * value, putting "dump-9" before "dump-10".
+   */
+  bool natural_less(const std::string& left, const std::string& right)
+  {
+    std::string::const_iterator i = left.begin();
+    std::string::const_iterator j = right.begin();
+
+    while (i != left.end() && j != right.end()) {
+      if (is_digit(*i) && is_digit(*j)) {
+        std::string::const_iterator a = i, b = j;
+        while (a != left.end() && *a == '0') ++a;
+        while (b != right.end() && *b == '0') ++b;
+        i = a; j = b;
+        while (i != left.end() && is_digit(*i)) ++i;
+        while (j != right.end() && is_digit(*j)) ++j;
+
+        if (i - a != j - b)
+          return i - a < j - b;
+        int order = std::string(a, i).compare(std::string(b, j));
+        if (order != 0)
+          return order < 0;
+      } else {
+        if (*i != *j)
+          return *i < *j;
+        ++i; ++j;
+      }
+    }
+    return j != right.end();
+  }
+
+  /**
+   * The dump files named by the DUMP-FILE argument.  "@LIST" names a
+   * file listing them in order, one per line.  A name with wildcards
+   * in it is expanded, and the files it matches are taken in natural
+   * order.  Anything else is the name of a single dump.
+   */
+  std::vector<filesystem::path> dump_files(const std::string& arg)
+  {
+    std::vector<filesystem::path> files;
+
+    if (arg.size() > 1 && arg[0] == '@') {
+      filesystem::ifstream in(filesystem::path(arg.substr(1)));
+      if (! in.good())
+        throw std::logic_error(std::string("Could not read dump list: ") +
+                               arg.substr(1));
+      std::string line;
+      while (std::getline(in, line))
+        if (! line.empty())
+          files.push_back(line);
+    }
+    else if (arg.find_first_of("*?[") != std::string::npos &&
+             ! filesystem::exists(arg)) {
+      glob_t matches;
+      if (::glob(arg.c_str(), 0, nullptr, &matches) == 0) {
+        std::vector<std::string> names(matches.gl_pathv,
+                                       matches.gl_pathv + matches.gl_pathc);
+        std::sort(names.begin(), names.end(), natural_less);
+        files.assign(names.begin(), names.end());
+      }
+      ::globfree(&matches);
+    }
+    else {
+      files.push_back(arg);
+    }
+
+    if (files.empty())
+      throw std::logic_error(std::string("No dump files match: ") + arg);
+    return files;
+  }
+
   template <typename T>
-  void invoke_scanner(SvnDump::File& dump) {
+  struct ScannerChunk
+  {
+    StatusDisplay status;
+    T             finder;
+
+    ScannerChunk() : status(std::cerr, quiet()), finder(status) {
+      prepare(finder);
+    }
+
+    static Options quiet() {
+      Options opts;
+      opts.quiet = true;
+      return opts;
+    }
+
+    static void prepare(Authors&) {}
+    static void prepare(Branches& branches) {
+      branches.deferred = true;
+    }
+  };
+
+  template <typename T>
+  void invoke_scanner(SvnDump::File& dump, const filesystem::path& pathname,
+                      bool mapped, int jobs) {
     StatusDisplay status(std::cerr);
     T finder(status);
 
-    while (dump.read_next(/* ignore_text= */ true)) {
-      status.set_final_rev(dump.get_last_rev_nr());
-      finder(dump, dump.get_curr_node());
+    if (! scan_chunks<ScannerChunk<T> >
+        (dump, pathname, mapped, jobs,
+         [](SvnDump::File& part, ScannerChunk<T>& chunk) {
+           while (part.read_next<T::fields>())
+             chunk.finder(part, part.get_curr_node());
+         },
+         [&](ScannerChunk<T>& chunk) {
+           finder.merge(chunk.finder);
+         })) {
+      while (dump.read_next<T::fields>()) {
+        status.set_final_rev(dump.get_last_rev_nr());
+        finder(dump, dump.get_curr_node());
+      }
     }
     finder.finish();
   }
@@ -65,20 +237,30 @@ int main(int argc, char *argv[])
 
   bool skip_preflight = false;
   bool verify         = false;
+  bool mapped         = false;
   int  start          = -1;
   int  cutoff         = -1;
+  int  jobs           = 1;
+  int  read_ahead     = 0;
+
+  SvnDump::CachePolicy cache_policy = SvnDump::CACHE_KEEP;
 
   filesystem::path authors_file;
   filesystem::path branches_file;
   filesystem::path modules_file;
 
+  SvnDump::PathFilter filter;
+
   std::vector<std::string> args;
 
   for (int i = 1; i < argc; ++i) {
-    if (argv[i][0] == '-') {
+    // A lone "-" names standard input as the dump file
+    if (argv[i][0] == '-' && argv[i][1] != '\0') {
       if (argv[i][1] == '-') {
         if (std::strcmp(&argv[i][2], "verify") == 0)
           verify = true;
+        else if (std::strcmp(&argv[i][2], "mmap") == 0)
+          mapped = true;
         else if (std::strcmp(&argv[i][2], "verbose") == 0)
           opts.verbose = true;
         else if (std::strcmp(&argv[i][2], "quiet") == 0)
@@ -99,6 +281,28 @@ int main(int argc, char *argv[])
           modules_file = argv[++i];
         else if (std::strcmp(&argv[i][2], "gc") == 0)
           opts.collect = lexical_cast<int>(argv[++i]);
+        else if (std::strcmp(&argv[i][2], "jobs") == 0)
+          jobs = lexical_cast<int>(argv[++i]);
+        else if (std::strcmp(&argv[i][2], "read-ahead") == 0)
+          read_ahead = lexical_cast<int>(argv[++i]);
+        else if (std::strcmp(&argv[i][2], "page-cache") == 0) {
+          std::string mode(argv[++i]);
+          if (mode == "keep")
+            cache_policy = SvnDump::CACHE_KEEP;
+          else if (mode == "drop")
+            cache_policy = SvnDump::CACHE_DROP_BEHIND;
+          else if (mode == "direct")
+            cache_policy = SvnDump::CACHE_DIRECT;
+          else {
+            std::cerr << "Unknown --page-cache mode: " << mode
+                      << " (expected keep, drop or direct)" << std::endl;
+            return 1;
+          }
+        }
+        else if (std::strcmp(&argv[i][2], "include") == 0)
+          filter.include(argv[++i]);
+        else if (std::strcmp(&argv[i][2], "exclude") == 0)
+          filter.exclude(argv[++i]);
       }
       else if (std::strcmp(&argv[i][1], "v") == 0)
         opts.verbose = true;
@@ -112,6 +316,8 @@ int main(int argc, char *argv[])
         branches_file = argv[++i];
       else if (std::strcmp(&argv[i][1], "M") == 0)
         modules_file = argv[++i];
+      else if (std::strcmp(&argv[i][1], "j") == 0)
+        jobs = lexical_cast<int>(argv[++i]);
     } else {
       args.push_back(argv[i]);
     }
@@ -170,18 +376,108 @@ int main(int argc, char *argv[])
   }
 
   try {
-    SvnDump::File dump(args[1]);
+    // Several dumps are read as one, but only a single dump file has a
+    // revision index or pre-scan cache kept beside it; a repository
+    // read directly, or a dump read from a pipe, has neither.
+    std::vector<filesystem::path> dumps(dump_files(args[1]));
+    filesystem::path              dump_path(dumps.front());
+    bool                          single =
+      dumps.size() == 1 && filesystem::is_regular_file(dump_path);
+
+    SvnDump::File dump(dumps, mapped, cache_policy);
 
     if (cmd == "print") {
       SvnDump::FilePrinter printer(dump);
-      while (dump.read_next(/* ignore_text= */ true))
-        printer(dump.get_curr_node());
+      if (! filter.empty())
+        dump.set_filter(&filter);
+      if (start != -1)
+        dump.seek_to_rev(start);
+      SvnDump::File::Revision batch;
+      while (dump.read_revision(batch, /* ignore_text= */ true)) {
+        int rev = batch.get_rev_nr();
+        if (cutoff != -1 && rev >= cutoff)
+          break;
+        if (start == -1 || rev >= start)
+          printer(batch);
+      }
+    }
+    else if (cmd == "index") {
+      // Reading the whole dump once records its revision index
+      if (! dump.has_index())
+        while (dump.read_next(/* ignore_text= */ true))
+          ;
+      if (dump.has_index())
+        std::cout << SvnDump::RevisionIndex::index_path(dump_path).string()
+                  << ": " << dump.get_index().entries.size()
+                  << " revisions" << std::endl;
+    }
+    else if (cmd == "digest") {
+      // The archive is named after a single dump unless it is given
+      filesystem::path archive_path;
+      if (args.size() > 2)
+        archive_path = args[2];
+      else if (single)
+        archive_path = dump_path.string() + ".digest";
+      else {
+        std::cerr << "usage: subconvert digest DUMP-FILE ARCHIVE"
+                  << std::endl;
+        return 1;
+      }
+
+      StatusDisplay status(std::cerr, opts, "Digesting");
+      SvnDump::ArchiveWriter writer(archive_path);
+
+      while (dump.read_next(/* ignore_text= */ false,
+                            /* verify=      */ true)) {
+        status.set_final_rev(dump.get_last_rev_nr());
+        status.update(dump.get_rev_nr());
+        writer.add(dump.get_curr_node());
+      }
+      writer.finish(dump.get_last_rev_nr());
+      status.finish();
+
+      std::cout << archive_path.string() << ": "
+                << writer.get_revision_count() << " revisions, "
+                << writer.get_node_count() << " nodes, "
+                << writer.get_text_count() << " texts in "
+                << writer.get_stored_bytes() << " bytes ("
+                << writer.get_duplicate_bytes() << " duplicate bytes dropped)"
+                << std::endl;
+    }
+    else if (cmd == "filter") {
+      if (args.size() < 3 || ! single) {
+        std::cerr << "usage: subconvert --include PATH filter DUMP-FILE OUTPUT"
+                  << std::endl;
+        return 1;
+      }
+
+      // Only the headers are parsed; what is kept is copied out of the
+      // dump file by its offsets
+      StatusDisplay       status(std::cerr, opts, "Filtering");
+      filesystem::path    output_path(args[2]);
+      SvnDump::DumpFilter output(dump, dump_path, filter, output_path);
+
+      while (dump.read_next(/* ignore_text= */ true,
+                            /* verify=      */ true)) {
+        status.set_final_rev(dump.get_last_rev_nr());
+        status.update(dump.get_rev_nr());
+        output.add(dump.get_curr_node());
+      }
+      output.finish();
+      status.finish();
+
+      (output_path == "-" ? std::cerr : std::cout)
+        << output_path.string() << ": "
+        << output.get_kept_nodes() << " nodes kept, "
+        << output.get_rewritten_copies() << " copies from outside the "
+        << "filter written as " << output.get_added_nodes() << " adds, "
+        << output.get_copied_bytes() << " bytes copied" << std::endl;
     }
     else if (cmd == "authors") {
-      invoke_scanner<Authors>(dump);
+      invoke_scanner<Authors>(dump, dump_path, mapped, jobs);
     }
     else if (cmd == "branches") {
-      invoke_scanner<Branches>(dump);
+      invoke_scanner<Branches>(dump, dump_path, mapped, jobs);
     }
     else if (cmd == "convert") {
       StatusDisplay status(std::cerr, opts);
@@ -208,24 +504,217 @@ int main(int argc, char *argv[])
       // Validate this information as much as possible before possibly
       // wasting the user's time with useless work.
 
+      // A dump being piped in can only be read once, so the pre-scan
+      // has to be skipped.  The converter then keeps every past tree,
+      // since it cannot know in advance which revisions later copies
+      // will refer to.
+      if (! skip_preflight && ! dump.can_rewind()) {
+        status.warn("Dump is not seekable; skipping the pre-scan.");
+        skip_preflight = true;
+      }
+
+      // The node headers seen by the pre-scan, by this one or an earlier
+      // one, are also a log from which the conversion reads the dump's
+      // nodes without parsing it again, once `logged' is set.
+      SvnDump::PrescanCache cache;
+      bool                  logged = false;
+
       if (! skip_preflight) {
         status.verb = "Scanning";
 
-        while (dump.read_next(/* ignore_text= */ false,
-                              /* verify=      */ true)) {
+        // Parts of the dump may be pre-scanned at the same time, since
+        // each node is checked on its own.
+        typedef ConvertRepository::PrescanResult PrescanResult;
 
-          int final_rev = dump.get_last_rev_nr();
+        std::atomic<int> last_rev(dump.get_last_rev_nr());
+
+        // Only the node headers matter to the pre-scan, so text bodies
+        // are skipped unless --verify asks for their checksums to be
+        // checked as well.
+        if (verify && ! SvnDump::Verifier::available()) {
+          status.warn("Checksums cannot be verified: built without libcrypto");
+          verify = false;
+        }
+
+        // Texts whose checksums do not match are errors like any other
+        auto report_checksums =
+          [](const SvnDump::Verifier::failures_list& failures,
+             PrescanResult& result) {
+          for (SvnDump::Verifier::failures_list::const_iterator
+                 i = failures.begin();
+               i != failures.end();
+               ++i) {
+            result.report((*i).rev, PrescanResult::ERROR, (*i).describe());
+            ++result.errors;
+          }
+        };
+
+        // The node headers seen by an earlier pre-scan of the same dump
+        // may be replayed instead of reading it again, checking them
+        // against the current authors and branches.  A full integrity
+        // check always reads the dump.
+        bool cached    = single && ! verify && cache.load(dump_path);
+        bool recording = single && ! cached && start == -1 && cutoff == -1;
+
+        struct PrescanChunk {
+          PrescanResult         result;
+          SvnDump::PrescanCache cache;
+        };
+
+        // Which paths outside --include are copied into it is only known
+        // once every node has been seen, so a filtered conversion reads
+        // all the node headers first, and then checks only the nodes it
+        // will convert.
+        if (! filter.empty() && ! cached) {
+          status.set_final_rev(dump.get_last_rev_nr());
+
+          if (verify || ! scan_chunks<SvnDump::PrescanCache>
+              (dump, dump_path, mapped, jobs,
+               [](SvnDump::File& part, SvnDump::PrescanCache& chunk) {
+                 while (part.read_next(/* ignore_text= */ true))
+                   chunk.add(part.get_curr_node());
+               },
+               [&](const SvnDump::PrescanCache& chunk) {
+                 cache.append(chunk);
+               })) {
+            shared_ptr<SvnDump::Verifier> verifier;
+            if (verify)
+              verifier.reset(new SvnDump::Verifier(jobs > 1 ? jobs : 0));
+
+            while (dump.read_next(/* ignore_text= */ !verify,
+                                  /* verify=      */ verify)) {
+              status.set_final_rev(dump.get_last_rev_nr());
+              status.update(dump.get_rev_nr());
+              cache.add(dump.get_curr_node());
+              if (verifier)
+                verifier->submit(dump.get_curr_node());
+            }
+
+            if (verifier) {
+              verifier->finish();
+
+              PrescanResult result;
+              report_checksums(verifier->get_failures(), result);
+              errors += converter.merge_prescan(result);
+            }
+          }
+
+          if (single)
+            cache.save(dump_path);
+          cached    = true;
+          recording = false;
+        }
+
+        if (! filter.empty()) {
+          std::size_t added = filter.add_copy_sources(cache);
+          if (added > 0) {
+            std::ostringstream buf;
+            buf << "Following " << added
+                << " copies from paths outside the filter";
+            status.info(buf.str());
+          }
+        }
+
+        if (cached) {
+          int final_rev = cache.last_rev();
           if (cutoff != -1 && cutoff < final_rev)
             final_rev = cutoff;
-
           status.set_final_rev(final_rev);
 
-          int rev = dump.get_rev_nr();
-          if (cutoff != -1 && rev >= cutoff)
-            break;
-          if (start == -1 || rev >= start)
-            errors += converter.prescan(dump.get_curr_node());
+          cache.replay([&](int rev, const std::string& author_id,
+                           SvnDump::File::Node::Action action,
+                           SvnDump::File::Node::Kind kind,
+                           const std::string& pathname, int copy_from_rev,
+                           const std::string& copy_from_path) {
+              if ((cutoff == -1 || rev < cutoff) &&
+                  (start == -1 || rev >= start) &&
+                  filter.match(pathname) != SvnDump::PathFilter::EXCLUDED) {
+                status.update(rev);
+
+                PrescanResult result;
+                converter.prescan(rev, author_id, action, kind, pathname,
+                                  copy_from_rev, copy_from_path, result);
+                errors += converter.merge_prescan(result);
+              }
+            });
         }
+        else if (! scan_chunks<PrescanChunk>
+            (dump, dump_path, mapped, jobs,
+             [&](SvnDump::File& part, PrescanChunk& chunk) {
+               while (part.read_next(/* ignore_text= */ !verify,
+                                     /* verify=      */ verify)) {
+                 int rev = part.get_rev_nr();
+                 if (cutoff != -1 && rev >= cutoff)
+                   break;
+                 if (start == -1 || rev >= start) {
+                   SvnDump::Verifier::failures_list failures;
+                   converter.prescan(part.get_curr_node(), chunk.result);
+                   if (verify &&
+                       SvnDump::Verifier::check(part.get_curr_node(),
+                                                failures))
+                     report_checksums(failures, chunk.result);
+                   if (recording)
+                     chunk.cache.add(part.get_curr_node());
+                 }
+               }
+
+               int seen = part.get_rev_nr();
+               int prev = last_rev;
+               while (prev < seen && ! last_rev.compare_exchange_weak(prev, seen))
+                 ;
+             },
+             [&](const PrescanChunk& chunk) {
+               int final_rev = last_rev;
+               if (cutoff != -1 && cutoff < final_rev)
+                 final_rev = cutoff;
+
+               status.set_final_rev(final_rev);
+               errors += converter.merge_prescan(chunk.result);
+               if (recording)
+                 cache.append(chunk.cache);
+             })) {
+          if (start != -1)
+            dump.seek_to_rev(start);
+
+          // Each range above was hashed on its own thread; here the
+          // hashing is handed to a pool instead.
+          shared_ptr<SvnDump::Verifier> verifier;
+          if (verify)
+            verifier.reset(new SvnDump::Verifier(jobs > 1 ? jobs : 0));
+
+          while (dump.read_next(/* ignore_text= */ !verify,
+                                /* verify=      */ verify)) {
+
+            int final_rev = dump.get_last_rev_nr();
+            if (cutoff != -1 && cutoff < final_rev)
+              final_rev = cutoff;
+
+            status.set_final_rev(final_rev);
+
+            int rev = dump.get_rev_nr();
+            if (cutoff != -1 && rev >= cutoff)
+              break;
+            if (start == -1 || rev >= start) {
+              errors += converter.prescan(dump.get_curr_node());
+              if (recording)
+                cache.add(dump.get_curr_node());
+              if (verifier)
+                verifier->submit(dump.get_curr_node());
+            }
+          }
+
+          if (verifier) {
+            verifier->finish();
+
+            PrescanResult result;
+            report_checksums(verifier->get_failures(), result);
+            errors += converter.merge_prescan(result);
+          }
+        }
+
+        if (recording)
+          cache.save(dump_path);
+        logged = cached || recording;
         status.newline();
 
         converter.copy_from.sort(comparator());
@@ -251,38 +740,125 @@ int main(int argc, char *argv[])
 
         dump.rewind();
       }
+      else {
+        // Without a pre-scan, only an earlier one can say where copies
+        // into the filter come from
+        logged = single && dump.can_rewind() && cache.load(dump_path);
+        if (logged && ! filter.empty())
+          filter.add_copy_sources(cache);
+        else if (! filter.empty())
+          status.warn("Copies from paths outside the filter will not be "
+                      "followed without the pre-scan.");
+      }
+
+      if (logged)
+        dump.set_node_log(&cache);
+
+      if (! filter.empty())
+        dump.set_filter(&filter);
+
+      // Deltas in the dump may refer to texts already converted
+      dump.set_base_text_reader
+        (bind(&ConvertRepository::read_base_text, &converter, _1, _2));
 
       // If everything passed the preflight, perform the conversion.
+      // With a revision index, earlier revisions need not be parsed.
       status.verb = "Converting";
 
-      while (dump.read_next(/* ignore_text= */ false)) {
+      if (start != -1)
+        dump.seek_to_rev(start);
 
-        int final_rev = dump.get_last_rev_nr();
+      // Returns false once the cutoff revision is reached
+      auto convert_node = [&](SvnDump::File::Node& node, int final_rev) {
         if (cutoff != -1 && cutoff < final_rev)
           final_rev = cutoff;
 
         status.set_final_rev(final_rev);
 
-        int rev = dump.get_rev_nr();
+        int rev = node.get_rev_nr();
         if (cutoff != -1 && rev >= cutoff)
-          break;
+          return false;
         if (start == -1 || rev >= start)
-          converter(dump.get_curr_node());
+          converter(node);
         else
           status.update(rev);
+        return true;
+      };
+
+      if (read_ahead > 0) {
+        // Parse ahead on another thread, holding up to `read_ahead'
+        // megabytes of text that the converter has yet to reach.
+        SvnDump::ReadAhead reader(dump, std::size_t(read_ahead) << 20);
+        while (SvnDump::File::Node * node = reader.next())
+          if (! convert_node(*node, reader.get_last_rev_nr()))
+            break;
+      } else if (dump.is_mapped()) {
+        // Texts stay in the mapping, so a whole revision can be read in
+        // one batch without holding all of its texts in memory.
+        SvnDump::File::Revision batch;
+        while (dump.read_revision(batch, /* ignore_text= */ false)) {
+          int final_rev = dump.get_last_rev_nr();
+          if (cutoff != -1 && cutoff < final_rev)
+            final_rev = cutoff;
+
+          status.set_final_rev(final_rev);
+
+          int rev = batch.get_rev_nr();
+          if (cutoff != -1 && rev >= cutoff)
+            break;
+          if (start == -1 || rev >= start)
+            converter(batch);
+          else
+            status.update(rev);
+        }
+      } else {
+        while (dump.read_next(/* ignore_text= */ false))
+          if (! convert_node(dump.get_curr_node(), dump.get_last_rev_nr()))
+            break;
       }
       converter.finish();
     }
     else if (cmd == "scan") {
       StatusDisplay status(std::cerr, opts);
+
+      if (verify && ! SvnDump::Verifier::available()) {
+        status.warn("Checksums cannot be verified: built without libcrypto");
+        verify = false;
+      }
+
+      // Texts are hashed on other threads while the dump is read
+      shared_ptr<SvnDump::Verifier> verifier;
+      if (verify)
+        verifier.reset(new SvnDump::Verifier(jobs > 1 ? jobs : 0));
+
       while (dump.read_next(/* ignore_text= */ !verify,
                             /* verify=      */ verify)) {
         status.set_final_rev(dump.get_last_rev_nr());
         if (opts.verbose)
           status.update(dump.get_rev_nr());
+        if (verifier)
+          verifier->submit(dump.get_curr_node());
       }
       if (opts.verbose)
         status.finish();
+
+      if (verifier) {
+        verifier->finish();
+
+        const SvnDump::Verifier::failures_list&
+          failures(verifier->get_failures());
+        for (SvnDump::Verifier::failures_list::const_iterator
+               i = failures.begin();
+             i != failures.end();
+             ++i)
+          std::cerr << 'r' << (*i).rev << ": Error: " << (*i).describe()
+                    << std::endl;
+
+        std::cerr << "Verified " << verifier->get_checked() << " texts: "
+                  << failures.size() << " checksum errors" << std::endl;
+        if (! failures.empty())
+          return 1;
+      }
     }
   }
   catch (const std::exception& err) {
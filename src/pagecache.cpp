@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "pagecache.h"
+
+namespace SvnDump {
+
+CacheAdvisor::CacheAdvisor(int reader_fd, const char * _mapping)
+  : fd(-1), mapping(_mapping), dropped(0), requested(0)
+{
+#ifdef HAVE_POSIX_FADVISE
+  fd = ::dup(reader_fd);
+  if (fd >= 0)
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  restart(0);
+}
+
+CacheAdvisor::~CacheAdvisor()
+{
+  if (fd >= 0)
+    ::close(fd);
+}
+
+/**
+ * Only act once the reader has moved STEP bytes on, so that a dump of
+ * many small revisions does not cost a system call for each of them.
+ */
+void CacheAdvisor::advance(uint64_t offset)
+{
+#ifdef HAVE_POSIX_FADVISE
+  if (fd < 0)
+    return;
+
+  // Whole pages only, or the kernel would keep the partial ones
+  uint64_t behind = offset & ~uint64_t(4095);
+  if (behind >= dropped + STEP) {
+    if (mapping)
+      ::madvise(const_cast<char *>(mapping + dropped),
+                static_cast<std::size_t>(behind - dropped), MADV_DONTNEED);
+    ::posix_fadvise(fd, static_cast<off_t>(dropped),
+                    static_cast<off_t>(behind - dropped),
+                    POSIX_FADV_DONTNEED);
+    dropped = behind;
+  }
+
+  if (offset + WINDOW - STEP >= requested) {
+    ::posix_fadvise(fd, static_cast<off_t>(requested),
+                    static_cast<off_t>(offset + WINDOW - requested),
+                    POSIX_FADV_WILLNEED);
+    requested = offset + WINDOW;
+  }
+#endif
+}
+
+void CacheAdvisor::restart(uint64_t offset)
+{
+  dropped   = offset & ~uint64_t(4095);
+  requested = offset;
+  advance(offset);
+}
+
+FileInput::FileInput(const filesystem::path& file, bool _direct)
+  : fd(-1), direct(false), uncached(_direct), buffer(nullptr),
+    buffer_offset(0), next_offset(0), discard(0)
+{
+#ifdef O_DIRECT
+  if (_direct) {
+    fd = ::open(file.string().c_str(), O_RDONLY | O_DIRECT);
+    direct = fd >= 0;
+  }
+#endif
+  if (fd < 0)
+    fd = ::open(file.string().c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::logic_error(std::string("Could not open dump file: ") +
+                           file.string());
+#if ! defined(O_DIRECT) && defined(F_NOCACHE)
+  if (_direct)
+    direct = ::fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+  if (direct)
+    uncached = false;
+
+  void * addr;
+  if (::posix_memalign(&addr, ALIGNMENT, BUFFER_SIZE) != 0) {
+    ::close(fd);
+    throw std::bad_alloc();
+  }
+  buffer = static_cast<char *>(addr);
+  setg(buffer, buffer, buffer);
+}
+
+FileInput::~FileInput()
+{
+  std::free(buffer);
+  ::close(fd);
+}
+
+FileInput::int_type FileInput::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+
+  for (;;) {
+    ssize_t got = ::pread(fd, buffer, BUFFER_SIZE,
+                          static_cast<off_t>(next_offset));
+    if (got <= 0)
+      return traits_type::eof();
+
+#ifdef HAVE_POSIX_FADVISE
+    if (uncached)
+      ::posix_fadvise(fd, static_cast<off_t>(next_offset),
+                      static_cast<off_t>(got), POSIX_FADV_DONTNEED);
+#endif
+
+    std::size_t len = static_cast<std::size_t>(got);
+
+    buffer_offset = next_offset;
+    next_offset  += len;
+
+    if (len > discard) {
+      setg(buffer, buffer + discard, buffer + len);
+      discard = 0;
+      return traits_type::to_int_type(*gptr());
+    }
+
+    // The block ended before the position sought; this only happens
+    // at the end of the file.
+    discard -= len;
+    if (len < BUFFER_SIZE) {
+      setg(buffer, buffer, buffer);
+      return traits_type::eof();
+    }
+  }
+}
+
+FileInput::pos_type FileInput::seekoff(off_type off, std::ios::seekdir dir,
+                                       std::ios::openmode which)
+{
+  off_type base = 0;
+  if (dir == std::ios::cur) {
+    base = static_cast<off_type>(buffer_offset + (gptr() - eback()));
+  }
+  else if (dir == std::ios::end) {
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+      return pos_type(off_type(-1));
+    base = static_cast<off_type>(st.st_size);
+  }
+  return seekpos(pos_type(base + off), which);
+}
+
+/**
+ * Positions within the current block are reached by moving within the
+ * buffer.  Otherwise the next read starts at the aligned offset before
+ * `target', passing over the bytes in between.
+ */
+FileInput::pos_type FileInput::seekpos(pos_type target, std::ios::openmode)
+{
+  off_type offset = off_type(target);
+  if (offset < 0)
+    return pos_type(off_type(-1));
+
+  uint64_t where = static_cast<uint64_t>(offset);
+  if (where >= buffer_offset &&
+      where <= buffer_offset + static_cast<uint64_t>(egptr() - eback())) {
+    setg(eback(), eback() + (where - buffer_offset), egptr());
+    return target;
+  }
+
+  next_offset   = direct ? where & ~uint64_t(ALIGNMENT - 1) : where;
+  discard       = static_cast<std::size_t>(where - next_offset);
+  buffer_offset = where;
+  setg(buffer, buffer, buffer);
+  return target;
+}
+
+} // namespace SvnDump
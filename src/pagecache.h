@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _PAGECACHE_H
+#define _PAGECACHE_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  // How reading a dump treats the kernel's page cache.  By default it
+  // is left to the kernel, which keeps as much of a large dump as it
+  // can at the expense of the Git repository being written.
+  enum CachePolicy {
+    CACHE_KEEP,
+    CACHE_DROP_BEHIND,          // read ahead, and drop what has been read
+    CACHE_DIRECT                // read around the page cache
+  };
+
+  /**
+   * Advises the kernel about a file being read front to back.  A window
+   * ahead of the reader is requested with POSIX_FADV_WILLNEED, and what
+   * lies behind it is dropped with POSIX_FADV_DONTNEED.  If the file is
+   * also mapped, the mapped pages behind the reader are released too,
+   * since the kernel never drops pages that are still mapped.
+   *
+   * Where posix_fadvise(2) is not available, nothing is done.
+   */
+  class CacheAdvisor : public noncopyable
+  {
+    static const uint64_t WINDOW = 32 * 1024 * 1024;
+    static const uint64_t STEP   = 8 * 1024 * 1024;
+
+    int          fd;
+    const char * mapping;
+    uint64_t     dropped;       // everything before here has been dropped
+    uint64_t     requested;     // everything before here has been requested
+
+  public:
+    // The reader's descriptor is duplicated rather than reopened, so
+    // that POSIX_FADV_SEQUENTIAL applies to the reader's own reads.
+    CacheAdvisor(int reader_fd, const char * _mapping = nullptr);
+    ~CacheAdvisor();
+
+    // The reader is done with everything before `offset'
+    void advance(uint64_t offset);
+
+    // The reader has moved to `offset' other than by reading
+    void restart(uint64_t offset);
+  };
+
+  /**
+   * A stream buffer which reads a file through its own descriptor, in
+   * large blocks, so that the page cache can be managed for it.  With
+   * `direct', the file is opened with O_DIRECT and none of it passes
+   * through the page cache; blocks are then read at aligned offsets
+   * into an aligned buffer.  File systems which refuse O_DIRECT are
+   * read in the usual way, with each block dropped from the cache once
+   * it has been read.
+   */
+  class FileInput : public std::streambuf, public noncopyable
+  {
+    static const std::size_t ALIGNMENT   = 4096;
+    static const std::size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    int         fd;
+    bool        direct;
+    bool        uncached;       // drop each block once it has been read
+    char *      buffer;
+    uint64_t    buffer_offset;  // of eback() in the file
+    uint64_t    next_offset;    // of the next block to be read
+    std::size_t discard;        // bytes to pass over in that block
+
+  public:
+    FileInput(const filesystem::path& file, bool _direct);
+    ~FileInput();
+
+    int descriptor() const {
+      return fd;
+    }
+
+  protected:
+    virtual int_type underflow();
+    virtual pos_type seekoff(off_type off, std::ios::seekdir dir,
+                             std::ios::openmode which);
+    virtual pos_type seekpos(pos_type target, std::ios::openmode which);
+  };
+}
+
+#endif // _PAGECACHE_H
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "pathfilter.h"
+#include "prescan.h"
+
+namespace SvnDump {
+
+namespace {
+  struct Segment {
+    const char * data;
+    std::size_t  len;
+  };
+
+  bool segment_less(const std::pair<std::string, uint32_t>& entry,
+                    const Segment& seg) {
+    return entry.first.compare(0, entry.first.size(), seg.data, seg.len) < 0;
+  }
+
+  bool segment_equal(const std::pair<std::string, uint32_t>& entry,
+                     const Segment& seg) {
+    return entry.first.size() == seg.len &&
+      std::memcmp(entry.first.data(), seg.data, seg.len) == 0;
+  }
+}
+
+uint32_t PathFilter::Trie::child(uint32_t node, const char * seg,
+                                 std::size_t len) const
+{
+  const Segment key = { seg, len };
+  const Node&   n(nodes[node]);
+
+  std::vector<std::pair<std::string, uint32_t> >::const_iterator i =
+    std::lower_bound(n.children.begin(), n.children.end(), key,
+                     segment_less);
+  return (i != n.children.end() && segment_equal(*i, key)) ? (*i).second : 0;
+}
+
+/**
+ * Find the child of `node' for one segment, or its wildcard child,
+ * creating it if need be.
+ */
+uint32_t PathFilter::Trie::step(uint32_t node, const char * seg,
+                                std::size_t len, bool wildcard,
+                                bool& changed)
+{
+  uint32_t next = wildcard ? nodes[node].wildcard : child(node, seg, len);
+  if (next != 0)
+    return next;
+
+  next = static_cast<uint32_t>(nodes.size());
+  nodes.push_back(Node());
+  changed = true;
+
+  if (wildcard) {
+    nodes[node].wildcard = next;
+  } else {
+    const Segment key = { seg, len };
+    std::vector<std::pair<std::string, uint32_t> >&
+      children(nodes[node].children);
+    children.insert(std::lower_bound(children.begin(), children.end(),
+                                     key, segment_less),
+                    std::make_pair(std::string(seg, len), next));
+  }
+  return next;
+}
+
+/**
+ * Find the node for `path', creating any that are missing.  Unless the
+ * path is `literal', a segment of "*" matches any one segment.
+ */
+uint32_t PathFilter::Trie::descend(const std::string& path, bool literal,
+                                   bool& changed)
+{
+  uint32_t     node = 0;
+  const char * p    = path.data();
+  const char * end  = p + path.size();
+
+  while (p < end) {
+    const char * q = std::find(p, end, '/');
+    if (q != p) {
+      std::size_t len = static_cast<std::size_t>(q - p);
+      node = step(node, p, len, ! literal && len == 1 && *p == '*', changed);
+    }
+    p = q == end ? q : q + 1;
+  }
+  return node;
+}
+
+bool PathFilter::Trie::insert(const std::string& path, bool literal)
+{
+  bool     changed = false;
+  uint32_t node    = descend(path, literal, changed);
+  if (! nodes[node].terminal) {
+    nodes[node].terminal = true;
+    changed = true;
+  }
+  return changed;
+}
+
+/**
+ * Copy the patterns below `node' in `from' to below `at'.  Returns true
+ * if any of them were new.
+ */
+bool PathFilter::Trie::graft(uint32_t at, const Trie& from, uint32_t node)
+{
+  assert(&from != this);
+
+  const Node& src(from.nodes[node]);
+  bool        changed = false;
+
+  if (src.terminal && ! nodes[at].terminal) {
+    nodes[at].terminal = true;
+    changed = true;
+  }
+
+  for (std::vector<std::pair<std::string, uint32_t> >::const_iterator
+         i = src.children.begin();
+       i != src.children.end();
+       ++i) {
+    uint32_t next = step(at, (*i).first.data(), (*i).first.size(),
+                         false, changed);
+    if (graft(next, from, (*i).second))
+      changed = true;
+  }
+
+  if (src.wildcard) {
+    uint32_t next = step(at, "*", 1, true, changed);
+    if (graft(next, from, src.wildcard))
+      changed = true;
+  }
+  return changed;
+}
+
+PathFilter::Match
+PathFilter::Trie::walk(uint32_t node, const char * p, const char * end,
+                       std::vector<uint32_t> * reached) const
+{
+  const Node& n(nodes[node]);
+  if (n.terminal)
+    return INCLUDED;
+
+  while (p < end && *p == '/')
+    ++p;
+
+  if (p == end) {
+    if (n.children.empty() && n.wildcard == 0)
+      return EXCLUDED;
+    if (reached)
+      reached->push_back(node);
+    return ANCESTOR;
+  }
+
+  const char * q      = std::find(p, end, '/');
+  Match        result = EXCLUDED;
+
+  if (uint32_t next = child(node, p, static_cast<std::size_t>(q - p)))
+    result = walk(next, q, end, reached);
+  if (result != INCLUDED && n.wildcard != 0)
+    result = std::max(result, walk(n.wildcard, q, end, reached));
+  return result;
+}
+
+PathFilter::Match PathFilter::match(const char * path, std::size_t len) const
+{
+  const char * end    = path + len;
+  Match        source = sources.walk(0, path, end);
+
+  if (source == INCLUDED)
+    return INCLUDED;
+  if (excludes.walk(0, path, end) == INCLUDED)
+    return source;
+  if (includes.empty())
+    return INCLUDED;
+  return std::max(includes.walk(0, path, end), source);
+}
+
+/**
+ * A copy onto a parent of included paths only needs those parts of its
+ * source which land on them, so the patterns below `path' in `trie' are
+ * grafted onto the source.
+ */
+bool PathFilter::graft_copy(const Trie& trie, const std::string& path,
+                            const std::string& source)
+{
+  std::vector<uint32_t> reached;
+  trie.walk(0, path.data(), path.data() + path.size(), &reached);
+
+  bool changed = false;
+  for (std::vector<uint32_t>::const_iterator i = reached.begin();
+       i != reached.end();
+       ++i) {
+    // Copied out first, since `trie' may be `sources' itself
+    Trie part;
+    part.graft(0, trie, *i);
+
+    uint32_t at = sources.descend(source, true, changed);
+    if (sources.graft(at, part, 0))
+      changed = true;
+  }
+  return changed;
+}
+
+/**
+ * Sources added for one copy may make others into them relevant, so
+ * the copies are gone over until nothing more is added.
+ */
+std::size_t PathFilter::add_copy_sources(const PrescanCache& cache)
+{
+  std::size_t added = 0;
+  bool        changed;
+
+  do {
+    changed = false;
+    cache.replay([&](int, const std::string&, File::Node::Action,
+                     File::Node::Kind, const std::string& pathname,
+                     int copy_from_rev, const std::string& copy_from_path) {
+        if (copy_from_rev == -1)
+          return;
+
+        Match dest = match(pathname);
+        if (dest == EXCLUDED || match(copy_from_path) == INCLUDED)
+          return;
+
+        bool grown;
+        if (dest == INCLUDED) {
+          grown = sources.insert(copy_from_path, true);
+        } else {
+          grown = graft_copy(includes, pathname, copy_from_path);
+          if (graft_copy(sources, pathname, copy_from_path))
+            grown = true;
+        }
+
+        if (grown) {
+          ++added;
+          changed = true;
+        }
+      });
+  } while (changed);
+
+  return added;
+}
+
+} // namespace SvnDump
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef _PATHFILTER_H
+#define _PATHFILTER_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  class PrescanCache;
+
+  /**
+   * Decides which paths of a dump are converted, from --include and
+   * --exclude patterns.  A pattern names a path and everything below
+   * it, and each of its segments may be a "*" matching any one segment,
+   * so that a pattern for every branch is "branches" with a "*" segment
+   * after it.  Excluded paths are never included, and without any
+   * include patterns every other path is.
+   *
+   * The patterns are compiled into tries of path segments, so that
+   * matching a node's path while its headers are parsed costs a walk
+   * of its segments and no allocation.
+   */
+  class PathFilter
+  {
+  public:
+    enum Match {
+      EXCLUDED,
+      ANCESTOR,                 // a parent of some included path
+      INCLUDED
+    };
+
+  private:
+    struct Trie
+    {
+      struct Node {
+        // Sorted by segment; zero means no child, since the root is
+        // never one.
+        std::vector<std::pair<std::string, uint32_t> > children;
+        uint32_t wildcard;
+        bool     terminal;
+
+        Node() : wildcard(0), terminal(false) {}
+      };
+
+      std::vector<Node> nodes;
+
+      Trie() : nodes(1) {}
+
+      bool empty() const {
+        return nodes.size() == 1 && ! nodes[0].terminal;
+      }
+
+      uint32_t child(uint32_t node, const char * seg, std::size_t len) const;
+      uint32_t step(uint32_t node, const char * seg, std::size_t len,
+                    bool wildcard, bool& changed);
+      uint32_t descend(const std::string& path, bool literal, bool& changed);
+      bool     insert(const std::string& path, bool literal);
+      bool     graft(uint32_t at, const Trie& from, uint32_t node);
+
+      // INCLUDED if a pattern matches some prefix of the path, ANCESTOR
+      // if the path is a proper prefix of one.  The nodes where the
+      // path ends are added to `reached'.
+      Match walk(uint32_t node, const char * p, const char * end,
+                 std::vector<uint32_t> * reached = nullptr) const;
+    };
+
+    Trie includes;
+    Trie excludes;
+
+    // The paths which copies into included ones were made from, which
+    // must be read for those copies to be converted.  These are taken
+    // literally, and win over any exclude pattern.
+    Trie sources;
+
+    bool graft_copy(const Trie& trie, const std::string& path,
+                    const std::string& source);
+
+  public:
+    void include(const std::string& pattern) {
+      includes.insert(pattern, false);
+    }
+    void exclude(const std::string& pattern) {
+      excludes.insert(pattern, false);
+    }
+
+    bool empty() const {
+      return includes.empty() && excludes.empty();
+    }
+
+    Match match(const char * path, std::size_t len) const;
+    Match match(const std::string& path) const {
+      return match(path.data(), path.size());
+    }
+
+    // Follow the copies recorded by a pre-scan back to their sources,
+    // until every copy into an included path has its source included.
+    // Returns the number of sources added.
+    std::size_t add_copy_sources(const PrescanCache& cache);
+  };
+}
+
+#endif // _PATHFILTER_H
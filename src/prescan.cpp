@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "prescan.h"
+
+namespace SvnDump {
+
+namespace {
+  const char CACHE_MAGIC[8] = { 'S', 'V', 'N', 'P', 'S', 'C', '0', '2' };
+
+  struct CacheHeader {
+    char     magic[8];
+    uint64_t dump_size;
+    int64_t  dump_mtime;
+    uint64_t dump_hash;
+    uint64_t string_bytes;
+    uint64_t string_count;
+    uint64_t revision_count;
+    uint64_t entry_count;
+  };
+
+  const std::size_t SAMPLE_SIZE = 64 * 1024;
+
+  /**
+   * FNV-1a over the first and last SAMPLE_SIZE bytes of the dump.  Along
+   * with its size and modification time, this catches a dump replaced
+   * by another without its timestamp changing.
+   */
+  uint64_t sample_hash(const filesystem::path& dump, uint64_t size)
+  {
+    std::vector<char> sample(SAMPLE_SIZE);
+    uint64_t          hash = 14695981039346656037ULL;
+
+    filesystem::ifstream in(dump, std::ios::in | std::ios::binary);
+    for (int part = 0; part < 2; ++part) {
+      if (part == 1) {
+        if (size <= SAMPLE_SIZE)
+          break;
+        in.seekg(static_cast<std::streamoff>(size - SAMPLE_SIZE));
+      }
+      in.read(sample.data(), static_cast<std::streamsize>(sample.size()));
+      std::streamsize len = in.gcount();
+      for (std::streamsize i = 0; i < len; ++i) {
+        hash ^= static_cast<unsigned char>(sample[i]);
+        hash *= 1099511628211ULL;
+      }
+      in.clear();
+    }
+    return hash;
+  }
+
+  template <typename T>
+  bool read_array(std::istream& in, std::vector<T>& data, uint64_t count)
+  {
+    data.resize(count);
+    std::streamsize len = static_cast<std::streamsize>(count * sizeof(T));
+    in.read(reinterpret_cast<char *>(data.data()), len);
+    return in.gcount() == len;
+  }
+}
+
+uint32_t PrescanCache::intern(const std::string& str)
+{
+  std::unordered_map<std::string, uint32_t>::iterator i = string_ids.find(str);
+  if (i != string_ids.end())
+    return (*i).second;
+
+  uint32_t id = static_cast<uint32_t>(strings.size());
+  strings.push_back(str);
+  string_ids.insert(std::make_pair(str, id));
+  return id;
+}
+
+/**
+ * Record a node read from the dump, with or without its text.  The
+ * checksums of full texts are not kept, so that a conversion replaying
+ * the log sees what it would have read from a dump without --verify.
+ */
+void PrescanCache::add(const File::Node& node)
+{
+  if (revisions.empty() || revisions.back().rev != node.get_rev_nr()) {
+    Revision revision;
+    revision.rev    = node.get_rev_nr();
+    revision.author = intern(node.get_rev_author());
+    revision.log    = node.get_rev_log() ? intern(*node.get_rev_log()) : NONE;
+    revision.nodes  = 0;
+    revision.date   = static_cast<int64_t>(node.get_rev_date());
+    revisions.push_back(revision);
+  }
+  ++revisions.back().nodes;
+
+  Entry entry;
+  entry.path     = intern(node.get_path().string());
+  entry.action   = static_cast<uint8_t>(node.get_action());
+  entry.kind     = static_cast<uint8_t>(node.get_kind());
+  entry.flags    = 0;
+  entry.reserved = 0;
+  if (node.has_copy_from()) {
+    entry.copy_from_rev  = node.get_copy_from_rev();
+    entry.copy_from_path = intern(node.get_copy_from_path().string());
+  } else {
+    entry.copy_from_rev  = -1;
+    entry.copy_from_path = intern(std::string());
+  }
+
+  entry.md5            = intern(node.text_delta && node.md5_checksum ?
+                                *node.md5_checksum : std::string());
+  entry.delta_base_md5 = intern(node.delta_base_md5 ?
+                                *node.delta_base_md5 : std::string());
+  if (node.text_delta)
+    entry.flags |= FLAG_TEXT_DELTA;
+  if (node.props_delta)
+    entry.flags |= FLAG_PROPS_DELTA;
+
+  // The text follows the properties directly in the dump
+  entry.props_length = static_cast<uint32_t>(node.props_len);
+  entry.text_length  = static_cast<uint32_t>(node.text_size);
+  entry.offset       = node.props_len > 0 ? node.props_offset :
+    node.text_offset;
+
+  entries.push_back(entry);
+}
+
+void PrescanCache::append(const PrescanCache& other)
+{
+  std::vector<uint32_t> ids(other.strings.size());
+  for (std::size_t i = 0; i < other.strings.size(); ++i)
+    ids[i] = intern(other.strings[i]);
+
+  for (std::vector<Revision>::const_iterator i = other.revisions.begin();
+       i != other.revisions.end();
+       ++i) {
+    Revision revision(*i);
+    revision.author = ids[revision.author];
+    if (revision.log != NONE)
+      revision.log = ids[revision.log];
+    revisions.push_back(revision);
+  }
+
+  for (std::vector<Entry>::const_iterator i = other.entries.begin();
+       i != other.entries.end();
+       ++i) {
+    Entry entry(*i);
+    entry.path           = ids[entry.path];
+    entry.copy_from_path = ids[entry.copy_from_path];
+    entry.md5            = ids[entry.md5];
+    entry.delta_base_md5 = ids[entry.delta_base_md5];
+    entries.push_back(entry);
+  }
+}
+
+bool PrescanCache::load(const filesystem::path& dump)
+{
+  strings.clear();
+  string_ids.clear();
+  revisions.clear();
+  entries.clear();
+
+  filesystem::path pathname(cache_path(dump));
+  if (! filesystem::is_regular_file(pathname))
+    return false;
+
+  filesystem::ifstream in(pathname, std::ios::in | std::ios::binary);
+
+  CacheHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+
+  uint64_t size = filesystem::file_size(dump);
+  if (! in.good() ||
+      std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+      header.dump_size  != size ||
+      header.dump_mtime != filesystem::last_write_time(dump) ||
+      header.dump_hash  != sample_hash(dump, size))
+    return false;
+
+  // Strings are stored one after another, each ending with a NUL
+  std::vector<char> bytes;
+  if (! read_array(in, bytes, header.string_bytes) ||
+      ! read_array(in, revisions, header.revision_count) ||
+      ! read_array(in, entries, header.entry_count)) {
+    revisions.clear();
+    entries.clear();
+    return false;
+  }
+
+  strings.reserve(header.string_count);
+  for (const char * p = bytes.data(), * end = p + bytes.size(); p < end; ) {
+    const char * q = static_cast<const char *>(std::memchr(p, '\0', end - p));
+    if (! q)
+      break;
+    strings.push_back(std::string(p, q));
+    p = q + 1;
+  }
+
+  // Make sure every index refers to a string we have
+  bool valid = strings.size() == header.string_count;
+  uint64_t nodes = 0;
+  for (std::size_t i = 0; valid && i < revisions.size(); ++i) {
+    valid = revisions[i].author < strings.size() &&
+      (revisions[i].log == NONE || revisions[i].log < strings.size());
+    nodes += revisions[i].nodes;
+  }
+  valid = valid && nodes == entries.size();
+  for (std::size_t i = 0; valid && i < entries.size(); ++i)
+    valid = entries[i].path < strings.size() &&
+      entries[i].copy_from_path < strings.size() &&
+      entries[i].md5 < strings.size() &&
+      entries[i].delta_base_md5 < strings.size();
+
+  if (! valid) {
+    strings.clear();
+    revisions.clear();
+    entries.clear();
+  }
+  return valid;
+}
+
+/**
+ * Write the cache beside the dump.  As with the revision index, failing
+ * to do so is not an error.
+ */
+bool PrescanCache::save(const filesystem::path& dump) const
+{
+  std::string bytes;
+  for (std::vector<std::string>::const_iterator i = strings.begin();
+       i != strings.end();
+       ++i) {
+    bytes += *i;
+    bytes += '\0';
+  }
+
+  CacheHeader header;
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.dump_size      = filesystem::file_size(dump);
+  header.dump_mtime     = filesystem::last_write_time(dump);
+  header.dump_hash      = sample_hash(dump, header.dump_size);
+  header.string_bytes   = bytes.size();
+  header.string_count   = strings.size();
+  header.revision_count = revisions.size();
+  header.entry_count    = entries.size();
+
+  filesystem::path tmp(cache_path(dump).string() + ".tmp");
+  { filesystem::ofstream out(tmp, std::ios::out | std::ios::binary);
+    if (! out.good())
+      return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    out.write(reinterpret_cast<const char *>(revisions.data()),
+              static_cast<std::streamsize>(revisions.size() *
+                                           sizeof(Revision)));
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    if (! out.good())
+      return false;
+  }
+
+  boost::system::error_code ec;
+  filesystem::rename(tmp, cache_path(dump), ec);
+  return ! ec;
+}
+
+} // namespace SvnDump
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PRESCAN_H
+#define _PRESCAN_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * The node headers that the pre-scan of a conversion looks at, kept
+   * beside the dump as DUMP.prescan so that later runs over the same
+   * dump need not read it again.  Nothing here depends on the authors,
+   * branches or modules files; replaying the headers redoes every check
+   * against them.
+   *
+   * The cache is only trusted while the dump's size, modification time
+   * and a hash of its first and last 64 KB still match.
+   *
+   * It also serves as a log of the dump's nodes for the conversion that
+   * follows, noting where each node's properties and text lie in the
+   * dump.  Once it is given to File::set_node_log(), the dump's headers
+   * are not parsed again; only the texts are read, at their offsets.
+   */
+  class PrescanCache
+  {
+  public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Revision {
+      int32_t  rev;
+      uint32_t author;          // index into `strings'
+      uint32_t log;             // NONE if the revision has no log
+      uint32_t nodes;
+      int64_t  date;
+    };
+
+    enum {
+      FLAG_TEXT_DELTA  = 0x01,
+      FLAG_PROPS_DELTA = 0x02
+    };
+
+    struct Entry {
+      uint32_t path;            // index into `strings'
+      uint32_t copy_from_path;
+      int32_t  copy_from_rev;   // -1 if not a copy
+      uint32_t md5;             // of a delta's full text, or ""
+      uint32_t delta_base_md5;  // or ""
+      uint8_t  action;
+      uint8_t  kind;
+      uint8_t  flags;
+      uint8_t  reserved;
+      uint32_t props_length;
+      uint32_t text_length;
+      uint64_t offset;          // in the dump of the properties, then text
+    };
+
+  private:
+    std::vector<std::string> strings;
+    std::vector<Revision>    revisions;
+    std::vector<Entry>       entries;
+
+    std::unordered_map<std::string, uint32_t> string_ids;
+
+    uint32_t intern(const std::string& str);
+
+  public:
+    static filesystem::path cache_path(const filesystem::path& dump) {
+      return filesystem::path(dump.string() + ".prescan");
+    }
+
+    bool load(const filesystem::path& dump);
+    bool save(const filesystem::path& dump) const;
+
+    bool empty() const {
+      return revisions.empty();
+    }
+    int last_rev() const {
+      return revisions.empty() ? -1 : revisions.back().rev;
+    }
+
+    std::size_t revision_count() const {
+      return revisions.size();
+    }
+    const Revision& get_revision(std::size_t i) const {
+      return revisions[i];
+    }
+    const Entry& get_entry(uint64_t i) const {
+      return entries[i];
+    }
+    const std::string& get_string(uint32_t i) const {
+      return strings[i];
+    }
+
+    void add(const File::Node& node);
+
+    // Append what another cache recorded for the revisions after ours
+    void append(const PrescanCache& other);
+
+    // Call `visit' with the headers of every node, in dump order
+    template <typename Visit>
+    void replay(Visit visit) const {
+      std::vector<Entry>::const_iterator entry = entries.begin();
+      for (std::vector<Revision>::const_iterator i = revisions.begin();
+           i != revisions.end();
+           ++i) {
+        const std::string& author(strings[(*i).author]);
+        for (uint32_t j = 0; j < (*i).nodes; ++j, ++entry)
+          visit((*i).rev, author,
+                static_cast<File::Node::Action>((*entry).action),
+                static_cast<File::Node::Kind>((*entry).kind),
+                strings[(*entry).path], (*entry).copy_from_rev,
+                strings[(*entry).copy_from_path]);
+      }
+    }
+  };
+}
+
+#endif // _PRESCAN_H
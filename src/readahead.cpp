@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "readahead.h"
+
+namespace SvnDump {
+
+namespace {
+  /**
+   * Wait for `ready' to hold, yielding at first and then sleeping
+   * briefly, since the other side may be busy for some time.
+   */
+  template <typename Predicate>
+  void wait_until(Predicate ready)
+  {
+    for (int tries = 0; ! ready(); ++tries) {
+      if (tries < 64)
+        std::this_thread::yield();
+      else
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+  }
+}
+
+ReadAhead::ReadAhead(File& _dump, std::size_t _max_bytes)
+  : dump(_dump), max_bytes(_max_bytes), slots(SLOTS), head(0), tail(0),
+    buffered(0), finished(false), stopping(false), holding(false),
+    final_rev(-1)
+{
+  worker = std::thread(&ReadAhead::run, this);
+}
+
+ReadAhead::~ReadAhead()
+{
+  stopping.store(true);
+  worker.join();
+}
+
+void ReadAhead::run()
+{
+  try {
+    while (! stopping.load(std::memory_order_relaxed) &&
+           dump.read_next(/* ignore_text= */ false)) {
+      File::Node& node(dump.get_curr_node());
+      std::size_t bytes = node.get_raw_size();
+      std::size_t slot  = tail.load(std::memory_order_relaxed);
+
+      // Wait for a free slot, and for the text to fit; a node larger
+      // than the limit is let in once the queue has emptied.
+      wait_until([&]() {
+          std::size_t used = slot - head.load(std::memory_order_acquire);
+          return (stopping.load(std::memory_order_relaxed) ||
+                  (used < SLOTS &&
+                   (used == 0 ||
+                    buffered.load(std::memory_order_acquire) + bytes <=
+                    max_bytes)));
+        });
+      if (stopping.load(std::memory_order_relaxed))
+        break;
+
+      Item& item(slots[slot % SLOTS]);
+      item.node      = boost::move(node);
+      item.final_rev = dump.get_last_rev_nr();
+      item.bytes     = bytes;
+
+      buffered.fetch_add(bytes, std::memory_order_release);
+      tail.store(slot + 1, std::memory_order_release);
+    }
+  }
+  catch (const std::exception& err) {
+    failure = err.what();
+  }
+  finished.store(true, std::memory_order_release);
+}
+
+File::Node * ReadAhead::next()
+{
+  std::size_t slot = head.load(std::memory_order_relaxed);
+
+  if (holding) {
+    buffered.fetch_sub(slots[slot % SLOTS].bytes, std::memory_order_release);
+    head.store(++slot, std::memory_order_release);
+    holding = false;
+  }
+
+  wait_until([&]() {
+      return (tail.load(std::memory_order_acquire) != slot ||
+              finished.load(std::memory_order_acquire));
+    });
+
+  if (tail.load(std::memory_order_acquire) == slot) {
+    if (! failure.empty())
+      throw std::logic_error(failure);
+    return nullptr;
+  }
+
+  holding   = true;
+  final_rev = slots[slot % SLOTS].final_rev;
+  return &slots[slot % SLOTS].node;
+}
+
+} // namespace SvnDump
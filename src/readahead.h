@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _READAHEAD_H
+#define _READAHEAD_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * Parses a dump on a background thread, keeping the nodes read so
+   * far in a bounded single-producer, single-consumer queue, so that
+   * reading and parsing overlap with the work done on each node.
+   *
+   * The queue holds at most SLOTS nodes, and no more than `max_bytes'
+   * of text and properties beyond the node at its head.  Each node is
+   * moved out of the File as it is read, so texts are not copied.  A
+   * deltified text is still applied on the consumer's thread, the only
+   * one that touches the File's text cache.
+   */
+  class ReadAhead : public noncopyable
+  {
+    static const std::size_t SLOTS = 1024;
+
+    struct Item {
+      File::Node  node;
+      int         final_rev;
+      std::size_t bytes;
+    };
+
+    File&             dump;
+    std::size_t       max_bytes;
+    std::vector<Item> slots;
+
+    std::atomic<std::size_t> head;      // next slot to consume
+    std::atomic<std::size_t> tail;      // next slot to fill
+    std::atomic<std::size_t> buffered;  // bytes held by queued nodes
+    std::atomic<bool>        finished;  // the producer is done
+    std::atomic<bool>        stopping;  // the consumer wants it to quit
+    bool                     holding;   // the consumer has the head node
+    int                      final_rev;
+    std::string              failure;
+    std::thread              worker;
+
+  public:
+    ReadAhead(File& _dump, std::size_t _max_bytes);
+    ~ReadAhead();
+
+    // Returns the next node of the dump, which remains valid until the
+    // next call, or nullptr at the end of the dump.
+    File::Node * next();
+
+    // The final revision of the dump, as known when the node last
+    // returned by next() was read.
+    int get_last_rev_nr() const {
+      return final_rev;
+    }
+
+  private:
+    void run();
+  };
+}
+
+#endif // _READAHEAD_H
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "revindex.h"
+
+namespace SvnDump {
+
+namespace {
+  const char INDEX_MAGIC[8] = { 'S', 'V', 'N', 'I', 'D', 'X', '0', '1' };
+
+  struct IndexHeader {
+    char     magic[8];
+    uint64_t dump_size;
+    int64_t  dump_mtime;
+    uint64_t count;
+  };
+}
+
+bool RevisionIndex::load(const filesystem::path& dump)
+{
+  entries.clear();
+
+  filesystem::path pathname(index_path(dump));
+  if (! filesystem::is_regular_file(pathname))
+    return false;
+
+  filesystem::ifstream in(pathname, std::ios::in | std::ios::binary);
+
+  IndexHeader header;
+  in.read(reinterpret_cast<char *>(&header), sizeof(header));
+  if (! in.good() ||
+      std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+      header.dump_size  != filesystem::file_size(dump) ||
+      header.dump_mtime != filesystem::last_write_time(dump))
+    return false;
+
+  entries.resize(header.count);
+  in.read(reinterpret_cast<char *>(entries.data()),
+          static_cast<std::streamsize>(header.count * sizeof(Entry)));
+  if (in.gcount() != static_cast<std::streamsize>
+      (header.count * sizeof(Entry))) {
+    entries.clear();
+    return false;
+  }
+  return true;
+}
+
+/**
+ * Write the index beside the dump.  Failing to do so is not an error,
+ * since the index only saves time on later runs.
+ */
+bool RevisionIndex::save(const filesystem::path& dump) const
+{
+  IndexHeader header;
+  std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  header.dump_size  = filesystem::file_size(dump);
+  header.dump_mtime = filesystem::last_write_time(dump);
+  header.count      = entries.size();
+
+  filesystem::path tmp(index_path(dump).string() + ".tmp");
+  { filesystem::ofstream out(tmp, std::ios::out | std::ios::binary);
+    if (! out.good())
+      return false;
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(entries.data()),
+              static_cast<std::streamsize>(entries.size() * sizeof(Entry)));
+    if (! out.good())
+      return false;
+  }
+
+  boost::system::error_code ec;
+  filesystem::rename(tmp, index_path(dump), ec);
+  return ! ec;
+}
+
+/**
+ * Find the first revision numbered `rev' or higher.
+ */
+const RevisionIndex::Entry * RevisionIndex::find(int rev) const
+{
+  entries_list::const_iterator i =
+    std::lower_bound(entries.begin(), entries.end(), rev,
+                     [](const Entry& entry, int value) {
+                       return entry.rev < value;
+                     });
+  return i == entries.end() ? nullptr : &*i;
+}
+
+} // namespace SvnDump
@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _REVINDEX_H
+#define _REVINDEX_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * A sidecar file recording where each revision starts in a dump,
+   * along with how many nodes it has and how much text they carry.
+   * It is stored next to the dump as DUMP.idx, and is only trusted
+   * while the dump's size and modification time still match.
+   */
+  class RevisionIndex
+  {
+  public:
+    struct Entry {
+      int32_t  rev;
+      uint32_t nodes;
+      uint64_t offset;          // of the "Revision-number:" line
+      uint64_t text_bytes;
+    };
+
+    typedef std::vector<Entry> entries_list;
+
+    entries_list entries;
+
+    static filesystem::path index_path(const filesystem::path& dump) {
+      return filesystem::path(dump.string() + ".idx");
+    }
+
+    bool load(const filesystem::path& dump);
+    bool save(const filesystem::path& dump) const;
+
+    bool empty() const {
+      return entries.empty();
+    }
+    int last_rev() const {
+      return entries.empty() ? -1 : entries.back().rev;
+    }
+
+    const Entry * find(int rev) const;
+  };
+}
+
+#endif // _REVINDEX_H
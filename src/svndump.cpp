@@ -31,6 +31,10 @@
  */
 
 #include "svndump.h"
+#include "archive.h"
+#include "fsfs.h"
+#include "pathfilter.h"
+#include "prescan.h"
 
 #ifndef ASSERTS
 #undef assert
@@ -39,11 +43,660 @@
 
 namespace SvnDump {
 
+namespace {
+  /**
+   * Parse the decimal number at `p', which ends at `end' or at the first
+   * character that is not a digit.  Dump headers are machine written,
+   * so unlike atoi this needs no locale and no terminating NUL.
+   */
+  inline int parse_number(const char * p, const char * end)
+  {
+    bool negative = p < end && *p == '-';
+    if (negative)
+      ++p;
+
+    int value = 0;
+    for (; p < end && *p >= '0' && *p <= '9'; ++p)
+      value = value * 10 + (*p - '0');
+    return negative ? -value : value;
+  }
+
+  inline int parse_digits(const char * p, int count)
+  {
+    int value = 0;
+    for (int i = 0; i < count; ++i)
+      value = value * 10 + (p[i] - '0');
+    return value;
+  }
+
+  /**
+   * Days from 1970-01-01 to the given date of the proleptic Gregorian
+   * calendar, which is what timegm computes for the date part.
+   */
+  inline long days_from_civil(int year, int month, int day)
+  {
+    year -= month <= 2;
+    const long     era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 +
+                         static_cast<unsigned>(day) - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<long>(doe) - 719468;
+  }
+
+  /**
+   * Parse an svn:date value, which Subversion always writes in UTC as
+   * "YYYY-MM-DDTHH:MM:SS.ffffffZ".  Anything else is left to strptime.
+   */
+  std::time_t parse_date(const char * p, const char * end)
+  {
+    static const char pattern[] = "dddd-dd-ddTdd:dd:dd";
+    const std::size_t len = sizeof(pattern) - 1;
+
+    bool matches = static_cast<std::size_t>(end - p) >= len;
+    for (std::size_t i = 0; matches && i < len; ++i)
+      matches = pattern[i] == 'd' ? p[i] >= '0' && p[i] <= '9'
+                                  : p[i] == pattern[i];
+    if (matches)
+      return static_cast<std::time_t>
+        (days_from_civil(parse_digits(p, 4), parse_digits(p + 5, 2),
+                         parse_digits(p + 8, 2)) * 86400L +
+         parse_digits(p + 11, 2) * 3600L + parse_digits(p + 14, 2) * 60L +
+         parse_digits(p + 17, 2));
+
+    char date[64];
+    std::size_t date_len =
+      std::min(static_cast<std::size_t>(end - p), sizeof(date) - 1);
+    std::memcpy(date, p, date_len);
+    date[date_len] = '\0';
+
+    struct tm then;
+    std::memset(&then, 0, sizeof(then));
+    strptime(date, "%Y-%m-%dT%H:%M:%S", &then);
+    return timegm(&then);
+  }
+
+  template <std::size_t N>
+  inline bool field_is(const char * field, std::size_t len,
+                       const char (&name)[N])
+  {
+    return len == N - 1 && std::memcmp(field, name, N - 1) == 0;
+  }
+}
+
+void File::open(const filesystem::path& file, bool mapped,
+                CachePolicy policy)
+{
+  if (handle || decompressor || mapping || archive || fsfs)
+    close();
+
+  if (filesystem::is_directory(file) && FsfsRepository::detect(file)) {
+    pathname     = file;
+    cache_policy = policy;
+    input_offset = 0;
+    limit        = UINT64_MAX;
+    indexable    = false;
+    index_valid  = false;
+    recording    = false;
+    index.entries.clear();
+    text_cache.clear();
+
+    fsfs        = new FsfsRepository(file);
+    record_node = 0;
+    last_rev    = fsfs->get_youngest();
+    return;
+  }
+
+  // Standard input and named pipes can only be read once, front to
+  // back, so they are never probed for compression or mapped.
+  bool streaming = file == "-" || ! filesystem::is_regular_file(file);
+
+  if (! streaming && Archive::detect(file)) {
+    pathname     = file;
+    cache_policy = policy;
+    input_offset = 0;
+    limit        = UINT64_MAX;
+    indexable    = false;
+    index_valid  = false;
+    recording    = false;
+    index.entries.clear();
+    text_cache.clear();
+
+    archive     = new Archive(file);
+    record_rev  = 0;
+    record_node = record_end = 0;
+    last_rev    = archive->last_rev();
+    return;
+  }
+
+  Decompressor::Format format =
+    streaming ? Decompressor::FORMAT_NONE : Decompressor::detect(file);
+
+  pathname        = file;
+  cache_policy    = policy;
+  prev_rev_offset = 0;
+  input_offset    = 0;
+  limit        = UINT64_MAX;
+  indexable    = ! streaming;
+  index_valid  = ! streaming && index.load(file);
+  recording    = ! streaming && ! index_valid;
+  if (recording)
+    index.entries.clear();
+  text_cache.clear();
+
+  if (format != Decompressor::FORMAT_NONE) {
+    decompressor = new Decompressor(file, format, policy != CACHE_KEEP);
+
+    window.resize(1024 * 1024);
+    pos = end = window.data();
+  }
+  else if (mapped && ! streaming && policy != CACHE_DIRECT) {
+    int fd = ::open(file.string().c_str(), O_RDONLY);
+    if (fd < 0)
+      throw std::logic_error(std::string("Could not open dump file: ") +
+                             file.string());
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      throw std::logic_error(std::string("Could not stat dump file: ") +
+                             file.string());
+    }
+    mapping_len = static_cast<std::size_t>(st.st_size);
+
+    if (mapping_len > 0) {
+      void * addr = ::mmap(nullptr, mapping_len, PROT_READ, MAP_PRIVATE,
+                           fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        throw std::logic_error(std::string("Could not map dump file: ") +
+                               file.string());
+      }
+      ::madvise(addr, mapping_len, MADV_SEQUENTIAL);
+      mapping = static_cast<const char *>(addr);
+
+      if (policy == CACHE_DROP_BEHIND)
+        advisor = new CacheAdvisor(fd, mapping);
+    }
+    ::close(fd);        // the mapping keeps its own reference
+
+    pos = mapping;
+    end = mapping + mapping_len;
+    input_offset = mapping_len;
+  } else {
+    if (file == "-") {
+      handle = &std::cin;
+    }
+    else if (policy != CACHE_KEEP && ! streaming) {
+      file_input = new FileInput(file, policy == CACHE_DIRECT);
+      handle     = new std::istream(file_input);
+      if (policy == CACHE_DROP_BEHIND)
+        advisor = new CacheAdvisor(file_input->descriptor());
+    }
+    else {
+      handle = new filesystem::ifstream(file, std::ios::in | std::ios::binary);
+    }
+    seekable = ! streaming;
+
+    // Buffer up to 1 megabyte when reading the dump file; this is a
+    // nearly free 3% speed gain
+    window.resize(1024 * 1024);
+    pos = end = window.data();
+  }
+}
+
+void File::open(const std::vector<filesystem::path>& files, bool mapped,
+                CachePolicy policy)
+{
+  if (files.size() == 1) {
+    open(files.front(), mapped, policy);
+    return;
+  }
+
+  for (std::vector<filesystem::path>::const_iterator i = files.begin();
+       i != files.end();
+       ++i)
+    if ((filesystem::is_regular_file(*i) && Archive::detect(*i)) ||
+        (filesystem::is_directory(*i) && FsfsRepository::detect(*i)))
+      throw std::logic_error(std::string("Only dump files can be read "
+                                         "as part of a series: ") +
+                             (*i).string());
+
+  if (handle || decompressor || mapping || archive || fsfs)
+    close();
+
+  pathname        = files.front();
+  cache_policy    = policy;
+  prev_rev_offset = 0;
+  input_offset    = 0;
+  limit           = UINT64_MAX;
+  indexable       = false;
+  index_valid     = false;
+  recording       = false;
+  index.entries.clear();
+  text_cache.clear();
+
+  decompressor = new Decompressor(files, policy != CACHE_KEEP);
+
+  window.resize(1024 * 1024);
+  pos = end = window.data();
+}
+
+void File::rewind()
+{
+  // Archives and node logs are read from their first record again, and
+  // repositories from their first revision
+  record_rev  = 0;
+  record_node = record_end = 0;
+  fsfs_rev.reset();
+
+  if (fsfs) {
+    fsfs->restart(0);
+  }
+  else if (mapping) {
+    pos = mapping;
+  }
+  else if (decompressor) {
+    decompressor->restart();
+    pos = end = window.data();
+  }
+  else if (! archive && ! fsfs) {
+    if (! seekable)
+      throw std::logic_error("Cannot rewind a dump read from a pipe");
+    handle->clear();
+    handle->seekg(0, std::ios::beg);
+    pos = end = window.data();
+    input_offset = 0;
+  }
+  curr_node.reset();
+  node_pending = false;
+  curr_node.curr_txn = -1;
+  last_rev = curr_rev = -1;
+  rev_record = none;
+  if (archive)
+    last_rev = archive->last_rev();
+  else if (fsfs)
+    last_rev = fsfs->get_youngest();
+  else if (node_log)
+    last_rev = node_log->last_rev();
+
+  prev_rev_offset = 0;
+  if (advisor)
+    advisor->restart(0);
+
+  if (! index_valid && indexable && ! node_log) {
+    index.entries.clear();
+    recording = true;
+  }
+}
+
+void File::seek(uint64_t offset)
+{
+  if (archive || fsfs) {
+    // Neither is ever split, so they are only sought to their start
+    assert(offset == 0);
+    record_rev  = 0;
+    record_node = record_end = 0;
+    if (fsfs) {
+      fsfs_rev.reset();
+      fsfs->restart(0);
+    }
+    return;
+  }
+
+  if (mapping) {
+    pos = mapping + std::min(static_cast<std::size_t>(offset), mapping_len);
+  }
+  else if (decompressor) {
+    // Decompress again from the beginning, discarding up to `offset'
+    decompressor->restart();
+    pos = end = window.data();
+    input_offset = 0;
+    skip(static_cast<std::size_t>(offset));
+  }
+  else {
+    handle->clear();
+    handle->seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+    pos = end = window.data();
+    input_offset = offset;
+  }
+
+  prev_rev_offset = offset;
+  rev_record      = none;
+  if (advisor)
+    advisor->restart(offset);
+}
+
+bool File::seek_to_rev(int rev)
+{
+  if (archive) {
+    std::size_t i = archive->find(rev);
+    if (i == archive->revision_count())
+      return false;
+
+    record_rev  = i;
+    record_node = record_end = archive->get_revision(i).first_node;
+
+    curr_node.reset();
+    node_pending = false;
+    curr_node.curr_txn = -1;
+    curr_rev = -1;
+    return true;
+  }
+
+  if (fsfs) {
+    if (rev > fsfs->get_youngest())
+      return false;
+
+    fsfs->restart(std::max(rev, 0));
+    fsfs_rev.reset();
+    record_node = 0;
+
+    curr_node.reset();
+    node_pending = false;
+    curr_node.curr_txn = -1;
+    curr_rev = -1;
+    return true;
+  }
+
+  if (node_log) {
+    // The log does not note where each revision's nodes begin, so they
+    // are counted from the start
+    uint64_t first = 0;
+    std::size_t i = 0;
+    for (; i < node_log->revision_count(); ++i) {
+      if (node_log->get_revision(i).rev >= rev)
+        break;
+      first += node_log->get_revision(i).nodes;
+    }
+    if (i == node_log->revision_count())
+      return false;
+
+    record_rev  = i;
+    record_node = record_end = first;
+
+    curr_node.reset();
+    node_pending = false;
+    curr_node.curr_txn = -1;
+    curr_rev = -1;
+    return true;
+  }
+
+  if (! index_valid || ! can_rewind())
+    return false;
+
+  const RevisionIndex::Entry * entry = index.find(rev);
+  if (! entry)
+    return false;
+
+  seek(entry->offset);
+
+  curr_node.reset();
+  node_pending = false;
+  curr_node.curr_txn = -1;
+  curr_rev = -1;
+
+  // The index is complete, so there is nothing more to record
+  recording = false;
+  return true;
+}
+
+std::vector<uint64_t> File::split(std::size_t count)
+{
+  std::vector<uint64_t> boundaries(1, 0);
+  if (count < 2 || decompressor || archive || fsfs || ! can_rewind())
+    return boundaries;
+
+  uint64_t size = mapping ? mapping_len : filesystem::file_size(pathname);
+
+  if (index_valid) {
+    for (std::size_t i = 1; i < count; ++i) {
+      uint64_t target = size / count * i;
+      RevisionIndex::entries_list::const_iterator j =
+        std::lower_bound(index.entries.begin(), index.entries.end(), target,
+                         [](const RevisionIndex::Entry& entry,
+                            uint64_t value) {
+                           return entry.offset < value;
+                         });
+      if (j != index.entries.end() && (*j).offset > boundaries.back())
+        boundaries.push_back((*j).offset);
+    }
+    return boundaries;
+  }
+
+  // Without an index, look for the next revision header after each
+  // target offset.  Text bodies could contain something that looks
+  // like one, so callers must check that the ranges join up.
+  static const char   header[]   = "\nRevision-number: ";
+  static const size_t header_len = sizeof(header) - 1;
+
+  filesystem::ifstream in;
+  std::vector<char>    buf;
+  if (! mapping) {
+    in.open(pathname, std::ios::in | std::ios::binary);
+    buf.resize(1024 * 1024);
+  }
+
+  for (std::size_t i = 1; i < count; ++i) {
+    uint64_t target = std::max(size / count * i, boundaries.back() + 1);
+    uint64_t found  = UINT64_MAX;
+
+    if (mapping) {
+      if (target < size)
+        if (const void * p = ::memmem(mapping + target, size - target,
+                                      header, header_len))
+          found = static_cast<uint64_t>
+            (static_cast<const char *>(p) - mapping) + 1;
+    } else {
+      for (uint64_t offset = target; offset < size && found == UINT64_MAX; ) {
+        in.clear();
+        in.seekg(static_cast<std::streamoff>(offset), std::ios::beg);
+        in.read(buf.data(), static_cast<std::streamsize>(buf.size()));
+        std::size_t got = static_cast<std::size_t>(in.gcount());
+        if (got < header_len)
+          break;
+        if (const void * p = ::memmem(buf.data(), got, header, header_len))
+          found = offset + static_cast<uint64_t>
+            (static_cast<const char *>(p) - buf.data()) + 1;
+        else
+          offset += got - header_len + 1;
+      }
+    }
+
+    if (found == UINT64_MAX)
+      break;
+    boundaries.push_back(found);
+  }
+  return boundaries;
+}
+
+void File::set_range(uint64_t begin, uint64_t _limit)
+{
+  seek(begin);
+
+  curr_node.reset();
+  node_pending = false;
+  curr_node.curr_txn = -1;
+  curr_rev  = -1;
+  limit     = _limit;
+  recording = false;
+}
+
+void File::close()
+{
+  delete archive;
+  archive  = nullptr;
+  delete fsfs;
+  fsfs     = nullptr;
+  fsfs_rev.reset();
+  node_log = nullptr;
+  if (log_fd >= 0) {
+    ::close(log_fd);
+    log_fd = -1;
+  }
+  if (mapping) {
+    ::munmap(const_cast<char *>(mapping), mapping_len);
+    mapping     = nullptr;
+    mapping_len = 0;
+  }
+  delete advisor;
+  advisor = nullptr;
+  if (handle != &std::cin)
+    delete handle;
+  delete file_input;
+  file_input = nullptr;
+  recording = false;
+  handle   = nullptr;
+  seekable = false;
+  delete decompressor;
+  decompressor = nullptr;
+  pos = end = nullptr;
+}
+
+/**
+ * Make sure that at least `len' bytes are available between `pos' and
+ * `end'.  For a stream, any unconsumed data is moved to the front of
+ * the window, which grows if it is too small.  Returns false if the
+ * end of the dump is reached first.
+ */
+bool File::fill(std::size_t len)
+{
+  std::size_t avail = static_cast<std::size_t>(end - pos);
+  if (avail >= len || mapping || ! (handle || decompressor))
+    return avail >= len;
+
+  std::memmove(window.data(), pos, avail);
+  if (window.size() < len)
+    window.resize(std::max(len, window.size() * 2));
+
+  char * buf = window.data();
+  avail += read_raw(buf + avail, window.size() - avail);
+
+  pos = buf;
+  end = buf + avail;
+
+  return avail >= len;
+}
+
+/**
+ * Read up to `len' bytes from the underlying stream or decompressor,
+ * bypassing the window.  Returns less than `len' only at end of file.
+ */
+std::size_t File::read_raw(char * buf, std::size_t len)
+{
+  std::size_t total = 0;
+  if (decompressor) {
+    while (total < len) {
+      std::size_t got = decompressor->read(buf + total, len - total);
+      if (got == 0)
+        break;
+      total += got;
+    }
+  }
+  else if (handle->good()) {
+    handle->read(buf, static_cast<std::streamsize>(len));
+    total = static_cast<std::size_t>(handle->gcount());
+  }
+  input_offset += total;
+  return total;
+}
+
+/**
+ * Return the next line in the dump, without its terminating newline,
+ * along with the first colon within it (or nullptr).  The line is only
+ * valid until the window is next filled.
+ */
+bool File::read_line(const char *& line, std::size_t& len,
+                     const char *& colon)
+{
+  for (;;) {
+    std::size_t avail = static_cast<std::size_t>(end - pos);
+    if (const char * nl = find_line_end(pos, end, colon)) {
+      line = pos;
+      len  = static_cast<std::size_t>(nl - pos);
+      pos  = nl + 1;
+      return true;
+    }
+    if (! fill(avail + 1)) {
+      if (pos == end)
+        return false;
+
+      // The final line of the dump lacks a newline
+      line  = pos;
+      len   = static_cast<std::size_t>(end - pos);
+      colon = static_cast<const char *>(std::memchr(line, ':', len));
+      pos   = end;
+      return true;
+    }
+  }
+}
+
+/**
+ * Copy the next `len' bytes of the dump into `buf'.  Large texts are
+ * read directly from the stream, rather than through the window.
+ */
+void File::read_into(char * buf, std::size_t len)
+{
+  std::size_t avail = std::min(len, static_cast<std::size_t>(end - pos));
+  std::memcpy(buf, pos, avail);
+  pos += avail;
+
+  if (avail < len)
+    read_raw(buf + avail, len - avail);
+}
+
+void File::skip(std::size_t len)
+{
+  std::size_t avail = static_cast<std::size_t>(end - pos);
+  if (avail >= len) {
+    pos += len;
+  } else {
+    pos = end;
+    len -= avail;
+
+    if (seekable) {
+      handle->seekg(static_cast<std::streamoff>(len), std::ios::cur);
+      input_offset += len;
+    } else {
+      // Pipes and decompressed streams cannot seek, so read and discard
+      while (len > 0) {
+        std::size_t got =
+          read_raw(window.data(), std::min(len, window.size()));
+        if (got == 0)
+          break;
+        len -= got;
+      }
+    }
+  }
+}
+
 bool File::read_next(const bool ignore_text, const bool verify)
 {
-  static const int MAX_LINE = 8192;
+  return parse_next<FIELD_ALL>(ignore_text, verify);
+}
+
+/**
+ * The parser proper.  Every header and property that `Fields' does not
+ * ask for is tested against a constant, so that each instantiation only
+ * extracts what its reader uses.
+ */
+template <unsigned Fields>
+bool File::parse_next(bool ignore_text, bool verify)
+{
+  const bool want_rev_props = (Fields & (FIELD_AUTHOR | FIELD_DATE |
+                                         FIELD_LOG)) != 0;
+
+  if (! (Fields & FIELD_TEXT))
+    ignore_text = true;
+  if (! (Fields & FIELD_CHECKSUMS))
+    verify = false;
 
-  char linebuf[MAX_LINE + 1];
+  if (archive)
+    return read_archived(ignore_text, verify);
+  if (fsfs)
+    return read_fsfs(ignore_text, verify);
+  if (node_log)
+    return read_logged(ignore_text);
 
   enum state_t {
     STATE_ERROR,
@@ -56,151 +709,262 @@ bool File::read_next(const bool ignore_text, const bool verify)
   int  prop_content_length = -1;
   int  text_content_length = -1;
   bool saw_node_path       = false;
+  bool skip_node           = false;
 
-  while (handle->good() && ! handle->eof()) {
+  const char * line;
+  const char * colon;
+  std::size_t  line_len;
+
+  while (pos < end || fill(1)) {
     switch (state) {
     case STATE_NEXT:
       prop_content_length = -1;
       text_content_length = -1;
       saw_node_path       = false;
+      skip_node           = false;
 
       curr_node.reset();
 
-      if (handle->peek() == '\n')
-        handle->read(linebuf, 1);
+      if (*pos == '\n')
+        ++pos;
+      if (tell() >= limit)
+        return false;
       state = STATE_TAGS;
 
       // fall through...
 
     case STATE_TAGS:
-      handle->getline(linebuf, MAX_LINE);
+      if (! read_line(line, line_len, colon))
+        line_len = 0;
 
-      if (const char * p = std::strchr(linebuf, ':')) {
-        std::string property
-          (linebuf, 0, static_cast<std::string::size_type>(p - linebuf));
-        switch (property[0]) {
-        case 'C':
-          break;
+      if (line_len == 0) {
+        if (saw_node_path)
+          curr_node.header_len =
+            static_cast<std::size_t>(tell() - curr_node.header_offset);
+        else if (prop_content_length <= 0)
+          end_revision_record();
+
+        if (skip_node) {
+          if (prop_content_length > 0)
+            skip(static_cast<std::size_t>(prop_content_length));
+          if (text_content_length > 0)
+            skip(static_cast<std::size_t>(text_content_length));
+          state = STATE_NEXT;
+        }
+        else if (prop_content_length > 0)
+          state = STATE_PROPS;
+        else if (text_content_length > 0)
+          state = STATE_BODY;
+        else if (saw_node_path)
+          goto success;
+        else
+          state = STATE_NEXT;
+      }
+      else if (const char * p = colon) {
+        // Dispatch on the length of the header name first, so that
+        // most lines are classified without comparing any strings.
+        const std::size_t field_len = static_cast<std::size_t>(p - line);
+        const char *      value     = p + 2;
+        const char *      value_end = line + line_len;
 
-        case 'N':
-          if (property == "Node-path") {
+        switch (field_len) {
+        case 9:
+          if (field_is(line, field_len, "Node-path")) {
+            if (recording && ! index.empty())
+              ++index.entries.back().nodes;
             curr_node.curr_txn += 1;
-            curr_node.pathname = p + 2;
+            curr_node.header_offset = tell() - line_len - 1;
+            if (Fields & FIELD_PATH)
+              curr_node.pathname.assign(value, value_end);
             saw_node_path = true;
+            skip_node     = filter &&
+              filter->match(value, static_cast<std::size_t>
+                            (value_end - value)) == PathFilter::EXCLUDED;
           }
-          else if (property == "Node-kind") {
-            if (*(p + 2) == 'f')
+          else if ((Fields & FIELD_NODE) &&
+                   field_is(line, field_len, "Node-kind")) {
+            if (*value == 'f')
               curr_node.kind = Node::KIND_FILE;
-            else if (*(p + 2) == 'd')
+            else if (*value == 'd')
               curr_node.kind = Node::KIND_DIR;
           }
-          else if (property == "Node-action") {
-            if (*(p + 2) == 'a')
+          break;
+
+        case 10:
+          if (! (Fields & FIELD_TEXT))
+            break;
+          if (field_is(line, field_len, "Text-delta"))
+            curr_node.text_delta = *value == 't';
+          else if (field_is(line, field_len, "Prop-delta"))
+            curr_node.props_delta = *value == 't';
+          break;
+
+        case 11:
+          if ((Fields & FIELD_NODE) &&
+              field_is(line, field_len, "Node-action")) {
+            if (*value == 'a')
               curr_node.action = Node::ACTION_ADD;
-            else if (*(p + 2) == 'd')
+            else if (*value == 'd')
               curr_node.action = Node::ACTION_DELETE;
-            else if (*(p + 2) == 'c')
+            else if (*value == 'c')
               curr_node.action = Node::ACTION_CHANGE;
-            else if (*(p + 2) == 'r')
+            else if (*value == 'r')
               curr_node.action = Node::ACTION_REPLACE;
           }
-          else if (property == "Node-copyfrom-rev") {
-            curr_node.copy_from_rev = std::atoi(p + 2);
-          }
-          else if (property == "Node-copyfrom-path") {
-            curr_node.copy_from_path = p + 2;
-          }
           break;
 
-        case 'P':
-          if (property == "Prop-content-length")
-            prop_content_length = std::atoi(p + 2);
-          break;
+        case 15:
+          if (field_is(line, field_len, "Revision-number")) {
+            curr_rev  = parse_number(value, value_end);
 
-        case 'R':
-          if (property == "Revision-number") {
-            curr_rev  = std::atoi(p + 2);
-            rev_log   = none;
+            // A revision without an author or date keeps those of the
+            // one before it, as it always has
+            shared_ptr<RevisionInfo> info(new RevisionInfo);
+            if (Fields & FIELD_AUTHOR)
+              info->author = rev_info->author;
+            info->date = rev_info->date;
+            rev_info     = info;
             curr_node.curr_txn = -1;
+
+            // Only the revision before this one is dropped from the
+            // cache, since nodes of the last may still be in use
+            if (advisor) {
+              advisor->advance(prev_rev_offset);
+              prev_rev_offset = tell() - line_len - 1;
+            }
+
+            if (revision_handler)
+              rev_record = tell() - line_len - 1;
+
+            if (recording) {
+              RevisionIndex::Entry entry;
+              entry.rev        = curr_rev;
+              entry.nodes      = 0;
+              entry.offset     = tell() - line_len - 1;
+              entry.text_bytes = 0;
+              index.entries.push_back(entry);
+            }
           }
           break;
 
-        case 'T':
-          if (property == "Text-content-length")
-            text_content_length = std::atoi(p + 2);
-          else if (verify && property == "Text-content-md5")
-            curr_node.md5_checksum = p + 2;
-          else if (verify && property == "Text-content-sha1")
-            curr_node.sha1_checksum = p + 2;
+        case 16:
+          // Full texts made from deltas are cached by their checksum
+          if ((Fields & (FIELD_TEXT | FIELD_CHECKSUMS)) &&
+              (verify || curr_node.text_delta) &&
+              field_is(line, field_len, "Text-content-md5"))
+            curr_node.md5_checksum = std::string(value, value_end);
+          break;
+
+        case 17:
+          if ((Fields & FIELD_NODE) &&
+              field_is(line, field_len, "Node-copyfrom-rev"))
+            curr_node.copy_from_rev = parse_number(value, value_end);
+          else if (verify && field_is(line, field_len, "Text-content-sha1"))
+            curr_node.sha1_checksum = std::string(value, value_end);
+          break;
+
+        case 18:
+          if ((Fields & FIELD_NODE) &&
+              field_is(line, field_len, "Node-copyfrom-path"))
+            curr_node.copy_from_path = filesystem::path(value, value_end);
+          break;
+
+        case 19:
+          if (field_is(line, field_len, "Prop-content-length")) {
+            prop_content_length = parse_number(value, value_end);
+          }
+          else if (field_is(line, field_len, "Text-content-length")) {
+            text_content_length = parse_number(value, value_end);
+            if (recording && ! index.empty())
+              index.entries.back().text_bytes +=
+                static_cast<uint64_t>(text_content_length);
+          }
+          else if ((Fields & FIELD_TEXT) &&
+                   field_is(line, field_len, "Text-delta-base-md5")) {
+            curr_node.delta_base_md5 = std::string(value, value_end);
+          }
           break;
         }
       }
-      else if (linebuf[0] == '\0') {
-        if (prop_content_length > 0)
-          state = STATE_PROPS;
-        else if (text_content_length > 0)
-          state = STATE_BODY;
-        else if (saw_node_path)
-          goto success;
-        else
-          state = STATE_NEXT;
-      }
       break;
         
     case STATE_PROPS: {
       assert(prop_content_length > 0);
 
-      char *      buf;
-      bool        allocated;
-      char *      p;
-      char *      q;
-      int         len;
-      bool        is_key;
-      std::string property;
+      const char * buf;
+      const char * p;
+      const char * q;
+      int          len;
+      bool         is_key;
+      const char * key     = nullptr;
+      std::size_t  key_len = 0;
 
       if (curr_node.curr_txn >= 0) {
-        // Ignore properties that don't describe the revision itself;
-        // we just don't need to know for the purposes of this
-        // utility.
-        handle->seekg(prop_content_length, std::ios::cur);
+        // Node properties are only noted here, and decoded if the
+        // converter asks for them.  When text is being ignored, so are
+        // they, unless the dump is mapped.
+        std::size_t props_len = static_cast<std::size_t>(prop_content_length);
+
+        curr_node.props_offset = tell();
+        curr_node.props_len    = props_len;
+        if (! (Fields & FIELD_TEXT)) {
+          skip(props_len);
+        }
+        else if (mapping) {
+          if (! fill(props_len))
+            return false;
+          curr_node.props = pos;
+          pos += props_len;
+        }
+        else if (ignore_text) {
+          skip(props_len);
+        }
+        else {
+          curr_node.props_buffer = text_pool.acquire(props_len);
+          read_into(curr_node.props_buffer.data, props_len);
+          curr_node.props = curr_node.props_buffer.data;
+        }
         goto end_props;
       }
 
-      if (prop_content_length < MAX_LINE) {
-        handle->read(linebuf, prop_content_length);
-        buf = linebuf;
-        allocated = false;
-      } else {
-        buf = new char[prop_content_length + 1];
-        allocated = true;
-        handle->read(buf, prop_content_length);
+      if (! want_rev_props) {
+        skip(static_cast<std::size_t>(prop_content_length));
+        goto end_props;
       }
 
+      // The whole property block is parsed in place, whether it lies
+      // within the mapping or within the read window.
+      if (! fill(static_cast<std::size_t>(prop_content_length)))
+        return false;
+
+      buf = pos;
+      pos += prop_content_length;
+
       p = buf;
       while (p - buf < prop_content_length) {
         is_key = *p == 'K';
         if (is_key || *p == 'V') {
-          q = std::strchr(p, '\n');
+          q = find_line_end(p, buf + prop_content_length, colon);
           assert(q != nullptr);
-          *q = '\0';
-          len = std::atoi(p + 2);
+          len = parse_number(p + 2, q);
           p = q + 1;
           q = p + len;
-          *q = '\0';
-
-          if (is_key)
-            property   = p;
-          else if (property == "svn:date") {
-            struct tm then;
-            strptime(p, "%Y-%m-%dT%H:%M:%S", &then);
-            rev_date   = timegm(&then);
+
+          if (is_key) {
+            key     = p;
+            key_len = static_cast<std::size_t>(len);
           }
-          else if (property == "svn:author")
-            rev_author = p;
-          else if (property == "svn:log")
-            rev_log    = p;
-          else if (property == "svn:sync-last-merged-rev")
-            last_rev   = std::atoi(p);
+          else if ((Fields & FIELD_DATE) &&
+                   field_is(key, key_len, "svn:date"))
+            rev_info->date = parse_date(p, q);
+          else if ((Fields & FIELD_AUTHOR) &&
+                   field_is(key, key_len, "svn:author"))
+            rev_info->author.assign(p, static_cast<std::size_t>(len));
+          else if ((Fields & FIELD_LOG) &&
+                   field_is(key, key_len, "svn:log"))
+            rev_info->log = std::string(p, static_cast<std::size_t>(len));
+          else if (field_is(key, key_len, "svn:sync-last-merged-rev"))
+            last_rev   = parse_number(p, q);
 
           p = q + 1;
         } else {
@@ -210,10 +974,10 @@ bool File::read_next(const bool ignore_text, const bool verify)
         }
       }
 
-      if (allocated)
-        delete[] buf;
-
     end_props:
+      if (curr_node.curr_txn == -1)
+        end_revision_record();
+
       if (text_content_length > 0)
         state = STATE_BODY;
       else if (curr_rev == -1 || curr_node.curr_txn == -1)
@@ -224,90 +988,542 @@ bool File::read_next(const bool ignore_text, const bool verify)
     }
 
     case STATE_BODY:
+      curr_node.text_offset = tell();
+      curr_node.text_size   = static_cast<std::size_t>(text_content_length);
+
       if (ignore_text) {
-        handle->seekg(text_content_length, std::ios::cur);
+        skip(static_cast<std::size_t>(text_content_length));
       } else {
         assert(text_content_length > 0);
 
-        if (text_content_length > STATIC_BUFLEN) {
-          curr_node.text = new char[text_content_length];
-          curr_node.text_allocated = true;
+        std::size_t text_len = static_cast<std::size_t>(text_content_length);
+
+        if (mapping) {
+          // Hand out the text in place; it lives as long as the mapping
+          if (! fill(text_len))
+            return false;
+          curr_node.text = pos;
+          pos += text_len;
         } else {
-          curr_node.text = curr_node.static_buffer;
-        }
-        curr_node.text_len = static_cast<std::size_t>(text_content_length);
-
-        handle->read(curr_node.text, text_content_length);
-
-#ifdef HAVE_LIBCRYPTO
-        if (verify) {
-          unsigned char id[20];
-          char          checksum[41];
-#ifdef HAVE_OPENSSL_MD5_H
-          if (curr_node.has_md5()) {
-            MD5(reinterpret_cast<const unsigned char *>(curr_node.get_text()),
-                curr_node.get_text_length(), id);
-            std::sprintf(checksum,
-                         "%02x%02x%02x%02x%02x%02x%02x%02x"
-                         "%02x%02x%02x%02x%02x%02x%02x%02x",
-                         id[0],  id[1],  id[2],  id[3],
-                         id[4],  id[5],  id[6],  id[7],
-                         id[8],  id[9],  id[10], id[11],
-                         id[12], id[13], id[14], id[15]);
-            assert(curr_node.get_text_md5() == checksum);
-          }
-#endif // HAVE_OPENSSL_MD5_H
-#ifdef HAVE_OPENSSL_SHA_H
-          if (curr_node.has_sha1()) {
-            SHA1(reinterpret_cast<const unsigned char *>(curr_node.get_text()),
-                 curr_node.get_text_length(), id);
-            std::sprintf(checksum,
-                         "%02x%02x%02x%02x%02x%02x%02x%02x"
-                         "%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x%02x",
-                         id[0],  id[1],  id[2],  id[3],
-                         id[4],  id[5],  id[6],  id[7],
-                         id[8],  id[9],  id[10], id[11],
-                         id[12], id[13], id[14], id[15],
-                         id[16], id[17], id[18], id[19]);
-            assert(curr_node.get_text_sha1() == checksum);
-          }
-#endif // HAVE_OPENSSL_SHA_H
+          curr_node.text_buffer = text_pool.acquire(text_len);
+          read_into(curr_node.text_buffer.data, text_len);
+          curr_node.text = curr_node.text_buffer.data;
         }
-#endif // HAVE_LIBCRYPTO
+        curr_node.text_len = text_len;
       }
 
       if (curr_rev == -1 || curr_node.curr_txn == -1)
         state = STATE_NEXT;
       else
         goto success;
+      break;
 
     case STATE_ERROR:
       assert(false);
       return false;
     }
   }
+
+  // Having read the whole dump from the beginning, keep its revision
+  // index for later runs.
+  if (recording) {
+    recording   = false;
+    index_valid = true;
+    index.save(pathname);
+  }
   return false;
 
  success:
-  curr_node.rev_author = rev_author;
-  curr_node.rev_date   = rev_date;
-  curr_node.rev_log    = rev_log;
-  curr_node.curr_rev   = curr_rev;
+  curr_node.rev_info = rev_info;
+  curr_node.curr_rev = curr_rev;
+
+  return true;
+}
+
+/**
+ * Read the next node from a digested archive.  Its records already hold
+ * everything the parser would extract, and its texts and properties are
+ * handed out in place, as from a mapped dump.
+ */
+bool File::read_archived(bool ignore_text, bool verify)
+{
+  for (;;) {
+    curr_node.reset();
+
+    while (record_node == record_end) {
+      if (record_rev == archive->revision_count())
+        return false;
+
+      const Archive::Revision& record(archive->get_revision(record_rev++));
+
+      shared_ptr<RevisionInfo> info(new RevisionInfo);
+      info->author = archive->get_string(record.author);
+      info->date   = static_cast<std::time_t>(record.date);
+      if (record.log != Archive::NONE)
+        info->log = archive->get_string(record.log);
+      rev_info = info;
+
+      curr_rev           = record.rev;
+      curr_node.curr_txn = -1;
+      record_node        = record.first_node;
+      record_end         = record.first_node + record.nodes;
+    }
+
+    const Archive::Node& record(archive->get_node(record_node++));
+    curr_node.curr_txn += 1;
+
+    std::size_t  path_len;
+    const char * path = archive->get_string(record.path, path_len);
+    if (filter && filter->match(path, path_len) == PathFilter::EXCLUDED)
+      continue;
+
+    curr_node.pathname.assign(path, path + path_len);
+    curr_node.kind   = static_cast<Node::Kind>(record.kind);
+    curr_node.action = static_cast<Node::Action>(record.action);
+
+    if (record.copy_from_rev != -1)
+      curr_node.copy_from_rev = record.copy_from_rev;
+    if (record.copy_from_path != Archive::NONE)
+      curr_node.copy_from_path =
+        filesystem::path(archive->get_string(record.copy_from_path));
+
+    if (record.text != Archive::NONE && ! ignore_text)
+      curr_node.text = archive->get_text(record.text, curr_node.text_len);
+    if (record.props != Archive::NONE)
+      curr_node.props = archive->get_text(record.props, curr_node.props_len);
+
+    curr_node.text_delta  = record.flags & Archive::FLAG_TEXT_DELTA;
+    curr_node.props_delta = record.flags & Archive::FLAG_PROPS_DELTA;
+    if (record.delta_base_md5 != Archive::NONE)
+      curr_node.delta_base_md5 = archive->get_string(record.delta_base_md5);
+
+    if (record.md5 != Archive::NONE && (verify || curr_node.text_delta))
+      curr_node.md5_checksum = archive->get_string(record.md5);
+    if (record.sha1 != Archive::NONE && verify)
+      curr_node.sha1_checksum = archive->get_string(record.sha1);
+
+    curr_node.rev_info = rev_info;
+    curr_node.curr_rev = curr_rev;
+    return true;
+  }
+}
+
+/**
+ * Read the next node from an FSFS repository.  Its revisions are read
+ * ahead by the FsfsRepository on threads of its own, and each node's
+ * properties and text are copied out of them into buffers from the
+ * pool, as from a dump that is not mapped.
+ */
+bool File::read_fsfs(bool ignore_text, bool verify)
+{
+  for (;;) {
+    curr_node.reset();
+
+    while (! fsfs_rev || record_node == fsfs_rev->changes.size()) {
+      shared_ptr<const FsfsRevision> revision(fsfs->next());
+      if (! revision)
+        return false;
+
+      // A revision without an author or date keeps those of the one
+      // before it, as in a dump
+      shared_ptr<RevisionInfo> info(new RevisionInfo);
+      info->author = revision->author ? *revision->author : rev_info->author;
+      info->date   = rev_info->date;
+      if (revision->date)
+        info->date = parse_date(revision->date->data(),
+                                revision->date->data() +
+                                revision->date->size());
+      info->log = revision->log;
+      rev_info  = info;
+
+      fsfs_rev           = revision;
+      curr_rev           = revision->rev;
+      curr_node.curr_txn = -1;
+      record_node        = 0;
+    }
+
+    const FsfsChange& change(fsfs_rev->changes[record_node++]);
+    curr_node.curr_txn += 1;
+
+    if (filter && filter->match(change.path) == PathFilter::EXCLUDED)
+      continue;
+
+    curr_node.pathname = change.path;
+    curr_node.kind     = change.kind;
+    curr_node.action   = change.action;
+    if (change.copy_from_rev != -1) {
+      curr_node.copy_from_rev  = change.copy_from_rev;
+      curr_node.copy_from_path = filesystem::path(change.copy_from_path);
+    }
+
+    if (change.has_props) {
+      curr_node.props_len = change.props.size();
+      if (! ignore_text) {
+        curr_node.props_buffer = text_pool.acquire(change.props.size());
+        std::memcpy(curr_node.props_buffer.data, change.props.data(),
+                    change.props.size());
+        curr_node.props = curr_node.props_buffer.data;
+      }
+    }
+
+    if (change.has_text) {
+      curr_node.text_size = change.text.size();
+      if (! change.text.empty() && ! ignore_text) {
+        curr_node.text_buffer = text_pool.acquire(change.text.size());
+        std::memcpy(curr_node.text_buffer.data, change.text.data(),
+                    change.text.size());
+        curr_node.text     = curr_node.text_buffer.data;
+        curr_node.text_len = change.text.size();
+      }
+
+      if (verify && ! change.md5.empty())
+        curr_node.md5_checksum = change.md5;
+      if (verify && ! change.sha1.empty())
+        curr_node.sha1_checksum = change.sha1;
+    }
+
+    curr_node.rev_info = rev_info;
+    curr_node.curr_rev = curr_rev;
+    return true;
+  }
+}
+
+bool File::set_node_log(const PrescanCache * log)
+{
+  if (archive || fsfs || decompressor || ! (mapping || seekable))
+    return false;
+
+  if (! mapping) {
+    log_fd = ::open(pathname.string().c_str(), O_RDONLY);
+    if (log_fd < 0)
+      throw std::logic_error(std::string("Could not open dump file: ") +
+                             pathname.string());
+
+    // Texts read at random are still dropped behind the converter, and
+    // those a CACHE_DIRECT dump would read around the cache are too
+    if (cache_policy != CACHE_KEEP && ! advisor)
+      advisor = new CacheAdvisor(log_fd);
+  }
 
+  node_log  = log;
+  recording = false;
+  rewind();
   return true;
 }
 
+/**
+ * Read `len' bytes of the dump at `offset', as noted in the node log.
+ * They are handed out in place from a mapped dump, and otherwise read
+ * with pread(2) into a buffer from the pool.
+ */
+const char * File::read_at(uint64_t offset, std::size_t len,
+                           TextPool::Buffer& buffer)
+{
+  if (mapping) {
+    if (offset > mapping_len || len > mapping_len - offset)
+      throw std::logic_error(std::string("Node log does not match dump: ") +
+                             pathname.string());
+    return mapping + offset;
+  }
+
+  buffer = text_pool.acquire(len);
+  for (std::size_t done = 0; done < len; ) {
+    ssize_t got = ::pread(log_fd, buffer.data + done, len - done,
+                          static_cast<off_t>(offset + done));
+    if (got <= 0)
+      throw std::logic_error(std::string("Could not read dump file: ") +
+                             pathname.string());
+    done += static_cast<std::size_t>(got);
+  }
+  return buffer.data;
+}
+
+/**
+ * Read the next node from the pre-scan's node log.  Only the texts and
+ * properties are read from the dump; the rest is as the pre-scan found
+ * it.  Properties are skipped along with the text, unless the dump is
+ * mapped, as they are when parsing.
+ */
+bool File::read_logged(bool ignore_text)
+{
+  for (;;) {
+    curr_node.reset();
+
+    while (record_node == record_end) {
+      if (record_rev == node_log->revision_count())
+        return false;
+
+      const PrescanCache::Revision& record
+        (node_log->get_revision(record_rev++));
+
+      shared_ptr<RevisionInfo> info(new RevisionInfo);
+      info->author = node_log->get_string(record.author);
+      info->date   = static_cast<std::time_t>(record.date);
+      if (record.log != PrescanCache::NONE)
+        info->log = node_log->get_string(record.log);
+      rev_info = info;
+
+      curr_rev           = record.rev;
+      curr_node.curr_txn = -1;
+      record_end         = record_node + record.nodes;
+
+      // As when parsing, only the revision before this one is dropped
+      // from the cache
+      if (advisor && record.nodes > 0) {
+        advisor->advance(prev_rev_offset);
+        prev_rev_offset = node_log->get_entry(record_node).offset;
+      }
+    }
+
+    const PrescanCache::Entry& entry(node_log->get_entry(record_node++));
+    curr_node.curr_txn += 1;
+
+    const std::string& path(node_log->get_string(entry.path));
+    if (filter && filter->match(path) == PathFilter::EXCLUDED)
+      continue;
+
+    curr_node.pathname = path;
+    curr_node.kind     = static_cast<Node::Kind>(entry.kind);
+    curr_node.action   = static_cast<Node::Action>(entry.action);
+    if (entry.copy_from_rev != -1) {
+      curr_node.copy_from_rev  = entry.copy_from_rev;
+      curr_node.copy_from_path =
+        filesystem::path(node_log->get_string(entry.copy_from_path));
+    }
+
+    curr_node.props_offset = entry.offset;
+    curr_node.props_len    = entry.props_length;
+    if (entry.props_length > 0 && (mapping || ! ignore_text))
+      curr_node.props = read_at(entry.offset, entry.props_length,
+                                curr_node.props_buffer);
+
+    curr_node.text_offset = entry.offset + entry.props_length;
+    curr_node.text_size   = entry.text_length;
+    if (entry.text_length > 0 && ! ignore_text) {
+      curr_node.text     = read_at(curr_node.text_offset, entry.text_length,
+                                   curr_node.text_buffer);
+      curr_node.text_len = entry.text_length;
+    }
+
+    curr_node.text_delta  = entry.flags & PrescanCache::FLAG_TEXT_DELTA;
+    curr_node.props_delta = entry.flags & PrescanCache::FLAG_PROPS_DELTA;
+
+    const std::string& base(node_log->get_string(entry.delta_base_md5));
+    if (! base.empty())
+      curr_node.delta_base_md5 = base;
+    const std::string& md5(node_log->get_string(entry.md5));
+    if (! md5.empty())
+      curr_node.md5_checksum = md5;
+
+    curr_node.rev_info = rev_info;
+    curr_node.curr_rev = curr_rev;
+    return true;
+  }
+}
+
+// The fields read by the scanners, Authors::fields and Branches::fields
+template bool File::parse_next<File::FIELD_AUTHOR>(bool, bool);
+template bool File::parse_next<File::FIELD_DATE | File::FIELD_PATH |
+                               File::FIELD_NODE>(bool, bool);
+
+bool File::read_revision(Revision& batch, const bool ignore_text,
+                         const bool verify)
+{
+  batch.clear();
+
+  if (node_pending)
+    node_pending = false;
+  else if (! read_next(ignore_text, verify))
+    return false;
+
+  batch.rev      = curr_node.curr_rev;
+  batch.rev_info = curr_node.rev_info;
+
+  do {
+    if (curr_node.curr_rev != batch.rev) {
+      node_pending = true;
+      break;
+    }
+    batch.add(boost::move(curr_node));
+  }
+  while (read_next(ignore_text, verify));
+
+  return true;
+}
+
+void File::Revision::add(Node&& node)
+{
+  kinds.push_back(node.kind);
+  actions.push_back(node.action);
+  paths.push_back(store(node.pathname.string()));
+  if (node.copy_from_rev) {
+    copy_from_revs.push_back(*node.copy_from_rev);
+    copy_from_paths.push_back(store(node.copy_from_path ?
+                                    node.copy_from_path->string() : ""));
+  } else {
+    Span none = { 0, 0 };
+    copy_from_revs.push_back(-1);
+    copy_from_paths.push_back(none);
+  }
+  text_lengths.push_back(node.text_len);
+
+  nodes.push_back(boost::move(node));
+}
+
+void File::Revision::clear()
+{
+  rev = -1;
+  rev_info.reset();
+
+  nodes.clear();
+  kinds.clear();
+  actions.clear();
+  paths.clear();
+  copy_from_revs.clear();
+  copy_from_paths.clear();
+  text_lengths.clear();
+  arena.clear();
+}
+
+/**
+ * Look for the property `name' in the node's property block.  Returns 1
+ * if it is set, with its value in `value' and `value_len', -1 if a
+ * property delta deletes it, and 0 if the block does not mention it.
+ */
+int File::Node::find_property(const std::string& name, const char *& value,
+                              std::size_t& value_len) const
+{
+  if (! props)
+    return 0;
+
+  const char * p   = props;
+  const char * end = props + props_len;
+  const char * colon;
+
+  while (p < end && (*p == 'K' || *p == 'D')) {
+    bool         deleted = *p == 'D';
+    const char * q       = find_line_end(p, end, colon);
+    if (! q)
+      break;
+    std::size_t key_len = static_cast<std::size_t>(parse_number(p + 2, q));
+    const char * key    = q + 1;
+    if (key_len > static_cast<std::size_t>(end - key))
+      break;
+    p = key + key_len + 1;
+
+    bool matches = key_len == name.length() &&
+                   std::memcmp(key, name.data(), key_len) == 0;
+    if (deleted) {
+      if (matches)
+        return -1;
+      continue;
+    }
+
+    if (p >= end || *p != 'V' || ! (q = find_line_end(p, end, colon)))
+      break;
+    std::size_t len = static_cast<std::size_t>(parse_number(p + 2, q));
+    if (matches) {
+      value     = q + 1;
+      value_len = std::min(len, static_cast<std::size_t>(end - value));
+      return 1;
+    }
+    p = q + 1 + len + 1;
+  }
+  return 0;
+}
+
+bool File::Node::get_property(const std::string& name,
+                              std::string&       value) const
+{
+  const char * data;
+  std::size_t  len;
+  if (find_property(name, data, len) != 1)
+    return false;
+  value.assign(data, len);
+  return true;
+}
+
+bool File::Node::has_property(const std::string& name) const
+{
+  const char * data;
+  std::size_t  len;
+  return find_property(name, data, len) == 1;
+}
+
+bool File::Node::deletes_property(const std::string& name) const
+{
+  const char * data;
+  std::size_t  len;
+  return find_property(name, data, len) == -1;
+}
+
+/**
+ * Produce the full text of a node from its delta.  The base text is
+ * found by its checksum among recent texts, or else is asked of the
+ * base text reader.  A delta without a base applies to the empty text.
+ */
+void File::apply_delta(const Node& node)
+{
+  static const std::string empty_md5("d41d8cd98f00b204e9800998ecf8427e");
+
+  TextCache::text_ptr base;
+  if (node.delta_base_md5 && *node.delta_base_md5 != empty_md5) {
+    base = text_cache.find(*node.delta_base_md5);
+    if (! base) {
+      std::string * text = new std::string;
+      base = TextCache::text_ptr(text);
+      if (! base_text_reader || ! base_text_reader(node, *text)) {
+        std::ostringstream buf;
+        buf << "Could not find the base text of the delta for "
+            << node.get_path() << " in r" << node.get_rev_nr();
+        throw std::logic_error(buf.str());
+      }
+    }
+  }
+
+  std::string * text = new std::string;
+  node.delta_text = TextCache::text_ptr(text);
+  apply_svndiff(node.text, node.text_len,
+                base ? base->data() : "", base ? base->size() : 0,
+                *text);
+
+  if (node.md5_checksum)
+    text_cache.insert(*node.md5_checksum, node.delta_text);
+}
+
 void FilePrinter::operator()(const SvnDump::File::Node& node)
+{
+  print(dump.get_rev_nr(), node.get_txn_nr(), node.get_action(),
+        node.get_kind(), node.get_path().string(),
+        node.has_copy_from() ? node.get_copy_from_rev() : -1,
+        node.has_copy_from() ? node.get_copy_from_path().string() : "");
+}
+
+void FilePrinter::operator()(const SvnDump::File::Revision& batch)
+{
+  for (std::size_t i = 0; i < batch.size(); ++i)
+    print(batch.get_rev_nr(), static_cast<int>(i), batch.get_action(i),
+          batch.get_kind(i),
+          std::string(batch.get_path_data(i), batch.get_path_length(i)),
+          batch.get_copy_from_rev(i),
+          std::string(batch.get_copy_from_path_data(i),
+                      batch.get_copy_from_path_length(i)));
+}
+
+void FilePrinter::print(int rev, int txn, SvnDump::File::Node::Action action,
+                        SvnDump::File::Node::Kind kind,
+                        const std::string& path, int copy_from_rev,
+                        const std::string& copy_from_path)
 {
   { std::ostringstream buf;
-    buf << 'r' << dump.get_rev_nr() << ':' << (node.get_txn_nr() + 1);
+    buf << 'r' << rev << ':' << (txn + 1);
     std::cout.width(9);
     std::cout << std::right << buf.str() << ' ';
   }
 
   std::cout.width(8);
   std::cout << std::left;
-  switch (node.get_action()) {
+  switch (action) {
   case SvnDump::File::Node::ACTION_NONE:    std::cout << ' ';        break;
   case SvnDump::File::Node::ACTION_ADD:     std::cout << "add ";     break;
   case SvnDump::File::Node::ACTION_DELETE:  std::cout << "delete ";  break;
@@ -316,17 +1532,17 @@ void FilePrinter::operator()(const SvnDump::File::Node& node)
   }
 
   std::cout.width(5);
-  switch (node.get_kind()) {
+  switch (kind) {
   case SvnDump::File::Node::KIND_NONE: std::cout << ' ';     break;
   case SvnDump::File::Node::KIND_FILE: std::cout << "file "; break;
   case SvnDump::File::Node::KIND_DIR:  std::cout << "dir ";  break;
   }
 
-  std::cout << node.get_path();
+  std::cout << filesystem::path(path);
 
-  if (node.has_copy_from())
-    std::cout << " (copied from " << node.get_copy_from_path()
-              << " [r" <<  node.get_copy_from_rev() << "])";
+  if (copy_from_rev != -1)
+    std::cout << " (copied from " << filesystem::path(copy_from_path)
+              << " [r" << copy_from_rev << "])";
 
   std::cout << '\n';
 }
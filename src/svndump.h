@@ -34,21 +34,103 @@
 #define _SVNDUMP_H
 
 #include "system.hpp"
+#include "decompress.h"
+#include "delta.h"
+#include "delimit.h"
+#include "pagecache.h"
+#include "revindex.h"
+#include "textpool.h"
 
 using namespace boost;
 
 namespace SvnDump
 {
-  class File : public noncopyable
+  // The properties of a revision, read once and then shared by every
+  // node of that revision
+  struct RevisionInfo
   {
-    int         curr_rev;
-    int         last_rev;
-    std::string rev_author;
-    std::time_t rev_date;
+    std::string           author;
+    std::time_t           date;
+    optional<std::string> log;
+
+    RevisionInfo() : date(0) {}
+  };
 
-    optional<std::string> rev_log;
+  typedef shared_ptr<const RevisionInfo> RevisionInfoPtr;
 
-    filesystem::ifstream * handle;
+  class Archive;
+  class FsfsRepository;
+  struct FsfsRevision;
+  class PathFilter;
+  class PrescanCache;
+
+  class File : public noncopyable
+  {
+    int curr_rev;
+    int last_rev;
+
+    // Replaced, rather than modified, at each new revision, since nodes
+    // of the previous one may still refer to it
+    shared_ptr<RevisionInfo> rev_info;
+
+    filesystem::path       pathname;
+    std::istream *         handle;
+    bool                   seekable;
+    Decompressor *         decompressor;
+
+    // Unless the page cache is left alone, a dump that is not mapped
+    // is read through `file_input', and `advisor' drops each revision
+    // from the cache once it has been read.
+    CachePolicy            cache_policy;
+    FileInput *            file_input;
+    CacheAdvisor *         advisor;
+    uint64_t               prev_rev_offset;
+
+    // The revision index is either loaded from beside the dump, or
+    // recorded while reading the dump from start to finish.  Dumps read
+    // from a pipe, or from several files, have none.
+    RevisionIndex index;
+    bool          indexable;
+    bool          index_valid;
+    bool          recording;
+
+    // When the dump is memory-mapped, the whole file is the read window
+    // and `window' is unused.  Otherwise `window' buffers data read from
+    // `handle'.  In both cases the parser works between `pos' and `end'.
+    const char *      mapping;
+    std::size_t       mapping_len;
+    std::vector<char> window;
+    const char *      pos;
+    const char *      end;
+    uint64_t          input_offset; // offset in the dump of `end'
+    uint64_t          limit;        // no record starting here is read
+
+    // Full texts recently produced from deltas, by their checksum
+    TextCache text_cache;
+
+    // Buffers for node texts and properties read from a stream, which
+    // nodes give back when they are reset or destroyed
+    TextPool text_pool;
+
+    // Nodes whose paths this excludes are passed over
+    const PathFilter * filter;
+
+    // A dump digested into an Archive is read from its records instead,
+    // and so is one whose nodes the pre-scan logged, once `node_log' is
+    // set; their texts are then read from `log_fd' with pread(2).  Of
+    // the records, `record_node' is the next node to read and
+    // `record_end' the end of the current revision's nodes.
+    Archive *            archive;
+    const PrescanCache * node_log;
+    int                  log_fd;
+    std::size_t          record_rev;
+    uint64_t             record_node;
+    uint64_t             record_end;
+
+    // An FSFS repository is read directly, a revision at a time, with
+    // `record_node' the next of `fsfs_rev''s changes
+    FsfsRepository *               fsfs;
+    shared_ptr<const FsfsRevision> fsfs_rev;
 
   public:
     class Node
@@ -69,115 +151,151 @@ namespace SvnDump
       };
 
     private:
-#define STATIC_BUFLEN 4096
-
+      // `text' points either at `text_buffer', taken from the File's
+      // pool of buffers, or directly into the mapping of a memory-mapped
+      // dump file, which the File owns.
       int              curr_txn;
       filesystem::path pathname;
       Kind             kind;
       Action           action;
-      char *           text;
-      bool             text_allocated;
-      char             static_buffer[STATIC_BUFLEN];
+      const char *     text;
+      TextPool::Buffer text_buffer;
       std::size_t      text_len;
 
+      // Where the text lies in the dump, noted even when it is skipped
+      uint64_t         text_offset;
+      std::size_t      text_size;
+
+      // Where the node's record begins in the dump, and the length of
+      // its headers, so that the record can be copied out whole
+      uint64_t         header_offset;
+      std::size_t      header_len;
+
       optional<std::string>      md5_checksum;
       optional<std::string>      sha1_checksum;
       optional<int>              copy_from_rev;
       optional<filesystem::path> copy_from_path;
 
+      // For a deltified dump, `text' holds the svndiff delta, and the
+      // full text is only produced when first asked for.
+      bool                          text_delta;
+      optional<std::string>         delta_base_md5;
+      mutable TextCache::text_ptr   delta_text;
+      File *                        owner;
+
+      // The node's property block is only decoded when asked about.
+      // `props' points into the mapping of a memory-mapped dump, and
+      // otherwise into `props_buffer'.
+      uint64_t                      props_offset;
+      std::size_t                   props_len;
+      bool                          props_delta;
+      const char *                  props;
+      TextPool::Buffer              props_buffer;
+
       friend class File;
+      friend class Revision;
+      friend class ArchiveWriter;
+      friend class DumpFilter;
+      friend class PrescanCache;
+
+      RevisionInfoPtr rev_info;
+      int             curr_rev;
 
-      std::string           rev_author;
-      std::time_t           rev_date;
-      optional<std::string> rev_log;
-      int                   curr_rev;
+      const RevisionInfo& get_rev_info() const {
+        static const RevisionInfo no_info;
+        return rev_info ? *rev_info : no_info;
+      }
+
+      void free_text() {
+        if (text_buffer.data) {
+          assert(owner);
+          owner->text_pool.release(text_buffer);
+        }
+        text = nullptr;
+      }
+      void free_props() {
+        if (props_buffer.data) {
+          assert(owner);
+          owner->text_pool.release(props_buffer);
+        }
+        props = nullptr;
+      }
 
     public:
       int get_rev_nr() const {
         return curr_rev;
       }
-      std::string get_rev_author() const {
-        return rev_author;
+      const std::string& get_rev_author() const {
+        return get_rev_info().author;
       }
       std::time_t get_rev_date() const {
-        return rev_date;
+        return get_rev_info().date;
       }
-      optional<std::string> get_rev_log() const {
-        return rev_log;
+      const optional<std::string>& get_rev_log() const {
+        return get_rev_info().log;
       }
 
-      Node() : curr_txn(-1), text(nullptr), text_allocated(false),
-               text_len(0), curr_rev(-1) {}
+      Node() : curr_txn(-1), text(nullptr), text_len(0), text_offset(0),
+               text_size(0), header_offset(0), header_len(0),
+               text_delta(false), owner(nullptr),
+               props_offset(0), props_len(0),
+               props_delta(false), props(nullptr), curr_rev(-1) {}
 
-      Node(const Node& other) {
-        *this = other;
-      }
-      Node(Node&& other) {
+      // Nodes are only ever moved, from the File that read them to
+      // whoever converts them; copying one would duplicate its buffers.
+      Node(const Node&) = delete;
+      Node& operator=(const Node&) = delete;
+
+      Node(Node&& other) : text(nullptr), owner(nullptr), props(nullptr) {
         *this = boost::move(other);
       }
 
       ~Node() {
-        if (text_allocated) {
-          assert(text);
-          delete[] text;
-        }
+        free_text();
+        free_props();
       }
 
-      Node& operator=(const Node& other) {
-        curr_txn       = other.curr_txn;
-        pathname       = other.pathname;
-        kind           = other.kind;
-        action         = other.action;
-        text_allocated = other.text_allocated;
-        text_len       = other.text_len;
-        md5_checksum   = other.md5_checksum;
-        sha1_checksum  = other.sha1_checksum;
-        copy_from_rev  = other.copy_from_rev;
-        copy_from_path = other.copy_from_path;
-        rev_author     = other.rev_author;
-        rev_date       = other.rev_date;
-        rev_log        = other.rev_log;
-        curr_rev       = other.curr_rev;
-
-        if (! text_allocated) {
-          assert(text_len <= STATIC_BUFLEN);
-          std::memcpy(static_buffer, other.static_buffer, text_len);
-        } else {
-          assert(text_len > 0);
-          text = new char[text_len];
-          std::memcpy(text, other.text, text_len);
-        }
+      Node& operator=(Node&& other) {
+        if (this == &other)
+          return *this;
 
-        return *this;
-      }
+        free_text();
+        free_props();
 
-      Node& operator=(Node&& other) {
         curr_txn       = other.curr_txn;
-        pathname       = other.pathname;
+        pathname       = boost::move(other.pathname);
         kind           = other.kind;
         action         = other.action;
-        text_allocated = other.text_allocated;
+        text           = other.text;
+        text_buffer    = other.text_buffer;
         text_len       = other.text_len;
-        md5_checksum   = other.md5_checksum;
-        sha1_checksum  = other.sha1_checksum;
+        text_offset    = other.text_offset;
+        text_size      = other.text_size;
+        header_offset  = other.header_offset;
+        header_len     = other.header_len;
+        md5_checksum   = boost::move(other.md5_checksum);
+        sha1_checksum  = boost::move(other.sha1_checksum);
         copy_from_rev  = other.copy_from_rev;
-        copy_from_path = other.copy_from_path;
-        rev_author     = other.rev_author;
-        rev_date       = other.rev_date;
-        rev_log        = other.rev_log;
+        copy_from_path = boost::move(other.copy_from_path);
+        text_delta     = other.text_delta;
+        delta_base_md5 = boost::move(other.delta_base_md5);
+        delta_text     = boost::move(other.delta_text);
+        owner          = other.owner;
+        props_offset   = other.props_offset;
+        props_len      = other.props_len;
+        props_delta    = other.props_delta;
+        props          = other.props;
+        props_buffer   = other.props_buffer;
+        rev_info       = boost::move(other.rev_info);
         curr_rev       = other.curr_rev;
 
-        if (! text_allocated) {
-          assert(text_len <= STATIC_BUFLEN);
-          std::memcpy(static_buffer, other.static_buffer, text_len);
-        } else {
-          assert(text_len > 0);
-          text = other.text;
-
-          other.text           = nullptr;
-          other.text_allocated = false;
-          other.text_len       = 0;
-        }
+        // The buffers now belong to this node
+        other.text         = nullptr;
+        other.text_buffer  = TextPool::Buffer();
+        other.text_len     = 0;
+        other.props        = nullptr;
+        other.props_buffer = TextPool::Buffer();
+        other.props_len    = 0;
 
         return *this;
       }
@@ -188,18 +306,27 @@ namespace SvnDump
 
         pathname.clear();
 
-        if (text_allocated) {
-          delete[] text;
-          text_allocated = false;
-          text           = nullptr;
-        }
-        text_len = 0;
+        free_text();
+        text_len    = 0;
+        text_offset = 0;
+        text_size   = 0;
+
+        header_offset = 0;
+        header_len    = 0;
 
         md5_checksum   = none;
         sha1_checksum  = none;
         copy_from_rev  = none;
         copy_from_path = none;
-        rev_log        = none;
+        rev_info.reset();
+
+        text_delta     = false;
+        delta_base_md5 = none;
+        delta_text.reset();
+
+        free_props();
+        props_len      = 0;
+        props_delta    = false;
       }
 
       int get_txn_nr() const {
@@ -227,11 +354,44 @@ namespace SvnDump
         return text != nullptr;
       }
       const char * get_text() const {
-        return text;
+        return text_delta ? get_delta_text().data() : text;
       }
       std::size_t get_text_length() const {
-        return text_len;
+        return text_delta ? get_delta_text().size() : text_len;
+      }
+      bool is_text_delta() const {
+        return text_delta;
+      }
+
+      // The bytes of text and properties the node holds on to
+      std::size_t get_raw_size() const {
+        return text_len + props_len;
+      }
+
+      // Whether the node has a property block at all; when it does not,
+      // a changed node keeps the properties it had.  A property delta
+      // only lists the properties that changed.
+      bool has_props() const {
+        return props_len > 0;
+      }
+      bool is_props_delta() const {
+        return props_delta;
       }
+      bool get_property(const std::string& name, std::string& value) const;
+      bool has_property(const std::string& name) const;
+      bool deletes_property(const std::string& name) const;
+
+    private:
+      int find_property(const std::string& name, const char *& value,
+                        std::size_t& value_len) const;
+
+      const std::string& get_delta_text() const {
+        if (! delta_text)
+          owner->apply_delta(*this);
+        return *delta_text;
+      }
+
+    public:
       bool has_md5() const {
         return md5_checksum;
       }
@@ -246,66 +406,328 @@ namespace SvnDump
       }
     };
 
+    // All the nodes of one revision, as read by read_revision().  The
+    // fields most often consulted are also kept as parallel arrays, with
+    // the paths packed into a single arena, so that a large revision can
+    // be looked over without touching each node.  Clearing the batch
+    // gives back every node's buffers at once, while the arrays keep
+    // their capacity for the next revision.
+    class Revision : public noncopyable
+    {
+    public:
+      struct Span {
+        std::size_t offset;     // into the arena
+        std::size_t length;
+      };
+
+    private:
+      int             rev;
+      RevisionInfoPtr rev_info;
+
+      std::vector<Node>         nodes;
+      std::vector<Node::Kind>   kinds;
+      std::vector<Node::Action> actions;
+      std::vector<Span>         paths;
+      std::vector<int>          copy_from_revs; // -1 if not a copy
+      std::vector<Span>         copy_from_paths;
+      std::vector<std::size_t>  text_lengths;
+      std::vector<char>         arena;
+
+      friend class File;
+
+      Span store(const std::string& str) {
+        Span span = { arena.size(), str.length() };
+        arena.insert(arena.end(), str.begin(), str.end());
+        return span;
+      }
+      void add(Node&& node);
+
+    public:
+      Revision() : rev(-1) {}
+
+      void clear();
+
+      int get_rev_nr() const {
+        return rev;
+      }
+      RevisionInfoPtr get_rev_info() const {
+        return rev_info;
+      }
+
+      std::size_t size() const {
+        return nodes.size();
+      }
+      bool empty() const {
+        return nodes.empty();
+      }
+
+      Node& get_node(std::size_t i) {
+        return nodes[i];
+      }
+      const Node& get_node(std::size_t i) const {
+        return nodes[i];
+      }
+      Node::Kind get_kind(std::size_t i) const {
+        return kinds[i];
+      }
+      Node::Action get_action(std::size_t i) const {
+        return actions[i];
+      }
+      const char * get_path_data(std::size_t i) const {
+        return arena.data() + paths[i].offset;
+      }
+      std::size_t get_path_length(std::size_t i) const {
+        return paths[i].length;
+      }
+      bool has_copy_from(std::size_t i) const {
+        return copy_from_revs[i] != -1;
+      }
+      int get_copy_from_rev(std::size_t i) const {
+        return copy_from_revs[i];
+      }
+      const char * get_copy_from_path_data(std::size_t i) const {
+        return arena.data() + copy_from_paths[i].offset;
+      }
+      std::size_t get_copy_from_path_length(std::size_t i) const {
+        return copy_from_paths[i].length;
+      }
+      // The length of the text as stored in the dump, which for a
+      // deltified node is that of the delta
+      std::size_t get_text_length(std::size_t i) const {
+        return text_lengths[i];
+      }
+    };
+
   private:
     Node curr_node;
+    bool node_pending;          // curr_node begins the next revision
+
+    function<bool(const Node&, std::string&)> base_text_reader;
+
+    // Told of each revision record as it is parsed, even when none of
+    // its nodes are read; `rev_record' is where the current one began
+    function<void(int, uint64_t, uint64_t)> revision_handler;
+    optional<uint64_t>                      rev_record;
 
   public:
-    File() : curr_rev(-1), handle(nullptr) {}
-    File(const filesystem::path& file) : curr_rev(-1), handle(nullptr) {
-      open(file);
+    File() : curr_rev(-1), last_rev(-1), rev_info(new RevisionInfo),
+             handle(nullptr), seekable(false), decompressor(nullptr),
+             cache_policy(CACHE_KEEP), file_input(nullptr), advisor(nullptr),
+             prev_rev_offset(0), indexable(false), index_valid(false),
+             recording(false), mapping(nullptr), mapping_len(0),
+             pos(nullptr), end(nullptr), input_offset(0), limit(UINT64_MAX),
+             filter(nullptr), archive(nullptr), node_log(nullptr),
+             log_fd(-1), record_rev(0), record_node(0), record_end(0),
+             fsfs(nullptr), node_pending(false) {
+      curr_node.owner = this;
+    }
+    File(const filesystem::path& file, bool mapped = false,
+         CachePolicy policy = CACHE_KEEP)
+      : curr_rev(-1), last_rev(-1), rev_info(new RevisionInfo),
+        handle(nullptr), seekable(false), decompressor(nullptr),
+        cache_policy(CACHE_KEEP), file_input(nullptr), advisor(nullptr),
+        prev_rev_offset(0), indexable(false), index_valid(false),
+        recording(false), mapping(nullptr), mapping_len(0), pos(nullptr),
+        end(nullptr), input_offset(0), limit(UINT64_MAX), filter(nullptr),
+        archive(nullptr), node_log(nullptr), log_fd(-1), record_rev(0),
+        record_node(0), record_end(0), fsfs(nullptr), node_pending(false) {
+      curr_node.owner = this;
+      open(file, mapped, policy);
+    }
+    File(const std::vector<filesystem::path>& files, bool mapped = false,
+         CachePolicy policy = CACHE_KEEP)
+      : curr_rev(-1), last_rev(-1), rev_info(new RevisionInfo),
+        handle(nullptr), seekable(false), decompressor(nullptr),
+        cache_policy(CACHE_KEEP), file_input(nullptr), advisor(nullptr),
+        prev_rev_offset(0), indexable(false), index_valid(false),
+        recording(false), mapping(nullptr), mapping_len(0), pos(nullptr),
+        end(nullptr), input_offset(0), limit(UINT64_MAX), filter(nullptr),
+        archive(nullptr), node_log(nullptr), log_fd(-1), record_rev(0),
+        record_node(0), record_end(0), fsfs(nullptr), node_pending(false) {
+      curr_node.owner = this;
+      open(files, mapped, policy);
     }
     ~File() {
-      if (handle)
+      if (handle || decompressor || mapping || archive || fsfs)
         close();
     }
 
-    void open(const filesystem::path& file) {
-      if (handle)
-        close();
+    // If `mapped' is true, the dump is read through mmap(2), and the
+    // text of each node refers directly into the mapping rather than
+    // being copied out of it.  Compressed dumps are detected
+    // automatically and decompressed on a background thread; they are
+    // never mapped.  A pathname of "-" reads the dump from standard
+    // input, which, like a named pipe, is read strictly forward.
+    //
+    // `policy' says how the dump's pages are kept in the kernel's page
+    // cache.  CACHE_DIRECT reads are never mapped, and compressed dumps
+    // read that way are dropped behind the reader instead.
+    //
+    // An archive written by "subconvert digest" is detected as well, and
+    // is always mapped whatever `mapped' and `policy' say.  So is the
+    // directory of a local FSFS repository, whose revisions are then
+    // read straight from its files, as "svnadmin dump" would give them.
+    void open(const filesystem::path& file, bool mapped = false,
+              CachePolicy policy = CACHE_KEEP);
+
+    // Read several dump files one after the other as a single dump, as
+    // for the output of "svnadmin dump --incremental" in chunks.  They
+    // are read on a background thread, like a compressed dump, and are
+    // never mapped.  A single file is opened as above.
+    void open(const std::vector<filesystem::path>& files,
+              bool mapped = false, CachePolicy policy = CACHE_KEEP);
+    void rewind();
+    void close();
+
+    CachePolicy get_cache_policy() const {
+      return cache_policy;
+    }
+
+    bool can_rewind() const {
+      return mapping || archive || fsfs || decompressor || seekable;
+    }
 
-      handle = new filesystem::ifstream(file);
+    // Offset in the dump of the next byte to be parsed
+    uint64_t tell() const {
+      return input_offset - static_cast<uint64_t>(end - pos);
+    }
 
-      // Buffer up to 1 megabyte when reading the dump file; this is a
-      // nearly free 3% speed gain
-      static char read_buffer[1024 * 1024];
-      handle->rdbuf()->pubsetbuf(read_buffer, 1024 * 1024);
+    bool has_index() const {
+      return index_valid;
     }
-    void rewind() {
-      handle->clear();
-      handle->seekg(0, std::ios::beg);
-      curr_node.reset();
-      curr_node.curr_txn = -1;
-      last_rev = curr_rev = -1;
+    const RevisionIndex& get_index() const {
+      return index;
     }
-    void close() {
-      delete handle;
-      handle = nullptr;
+
+    // Using the revision index, position the dump at the first
+    // revision numbered `rev' or higher.  Returns false if there is no
+    // index, in which case nothing changes.
+    bool seek_to_rev(int rev);
+
+    // Split the dump into at most `count' ranges of revisions of about
+    // the same size, returning the offset where each range begins.
+    // Dumps that cannot be read at random yield a single range.
+    std::vector<uint64_t> split(std::size_t count);
+
+    // Read only the records which begin between `begin' and `_limit'.
+    // `begin' must be the start of a revision.
+    void set_range(uint64_t begin, uint64_t _limit);
+
+    bool is_mapped() const {
+      return mapping != nullptr || archive != nullptr;
     }
 
     int get_rev_nr() const {
       return curr_rev;
     }
     int get_last_rev_nr() const {
-      return last_rev;
+      return last_rev != -1 ? last_rev :
+        (index_valid ? index.last_rev() : -1);
     }
     Node& get_curr_node() {
       return curr_node;
     }
-    std::string get_rev_author() const {
-      return rev_author;
+    const std::string& get_rev_author() const {
+      return rev_info->author;
     }
     std::time_t get_rev_date() const {
-      return rev_date;
+      return rev_info->date;
     }
-    optional<std::string> get_rev_log() const {
-      return rev_log;
+    const optional<std::string>& get_rev_log() const {
+      return rev_info->log;
     }
 
+    // With `verify', the checksums of each text are kept in the node
+    // for a Verifier to check.
     bool read_next(const bool ignore_text = false,
                    const bool verify      = false);
 
+    // The parts of the dump a reader may ask read_next<>() for.  The
+    // revision number, and whether a record is a node, are always read.
+    enum Field {
+      FIELD_AUTHOR    = 0x01,   // svn:author of each revision
+      FIELD_DATE      = 0x02,   // svn:date
+      FIELD_LOG       = 0x04,   // svn:log
+      FIELD_PATH      = 0x08,   // the path of each node
+      FIELD_NODE      = 0x10,   // its kind, action and copy source
+      FIELD_TEXT      = 0x20,   // its properties, text and deltas
+      FIELD_CHECKSUMS = 0x40,   // the checksums of its text
+      FIELD_ALL       = 0x7f
+    };
+
+    // Read the next node, extracting only `Fields' from it.  A parser
+    // is compiled for each set of fields, which must be instantiated at
+    // the end of svndump.cpp.
+    template <unsigned Fields>
+    bool read_next() {
+      return parse_next<Fields>(false, false);
+    }
+
+    // Read every node of the next revision into `batch', returning
+    // false at the end of the dump.  Revisions without nodes are passed
+    // over, as they are by read_next().  The first node of the following
+    // revision is held back for the next call, so the two ways of
+    // reading should not be mixed without a rewind or seek in between.
+    bool read_revision(Revision&  batch,
+                       const bool ignore_text = false,
+                       const bool verify      = false);
+
+    // Nodes outside `_filter' are skipped as soon as their headers have
+    // been read, without reading their properties or text.  Revisions
+    // left without nodes are passed over.  The filter must outlive its
+    // use here; nullptr reads every node again.
+    void set_filter(const PathFilter * _filter) {
+      filter = _filter;
+    }
+
+    // Read the nodes recorded in `log' by the pre-scan, rather than
+    // parsing the dump again, reading their properties and texts from
+    // the dump at the offsets logged.  Returns false, changing nothing,
+    // if the dump cannot be read at random.  The log must cover the
+    // whole dump, and outlive its use here.
+    bool set_node_log(const PrescanCache * log);
+
+    // Deltas whose base text is no longer cached are applied to the
+    // text that `reader' finds for the node, returning false if it has
+    // none.  The converter reads it back from the Git repository.
+    void set_base_text_reader
+    (function<bool(const Node&, std::string&)> reader) {
+      base_text_reader = reader;
+    }
+
+    // `handler' is called with the number of each revision parsed from
+    // the dump, and the offset and length of its record, headers and
+    // properties, before any of its nodes are read.  Archives, node
+    // logs and repositories have no such records, and never call it.
+    void set_revision_handler
+    (function<void(int, uint64_t, uint64_t)> handler) {
+      revision_handler = handler;
+    }
+
   private:
-    void read_tags();
+    template <unsigned Fields>
+    bool        parse_next(bool ignore_text, bool verify);
+    bool        read_archived(bool ignore_text, bool verify);
+    bool        read_logged(bool ignore_text);
+    bool        read_fsfs(bool ignore_text, bool verify);
+    const char * read_at(uint64_t offset, std::size_t len,
+                         TextPool::Buffer& buffer);
+
+    void end_revision_record() {
+      if (rev_record) {
+        revision_handler(curr_rev, *rev_record, tell() - *rev_record);
+        rev_record = none;
+      }
+    }
+
+    void        apply_delta(const Node& node);
+    void        seek(uint64_t offset);
+    bool        fill(std::size_t len);
+    std::size_t read_raw(char * buf, std::size_t len);
+    bool        read_line(const char *& line, std::size_t& len,
+                          const char *& colon);
+    void        read_into(char * buf, std::size_t len);
+    void        skip(std::size_t len);
   };
 
   struct FilePrinter
@@ -315,6 +737,12 @@ namespace SvnDump
     FilePrinter(const SvnDump::File& _dump) : dump(_dump) {}
 
     void operator()(const SvnDump::File::Node& node);
+    void operator()(const SvnDump::File::Revision& batch);
+
+  private:
+    void print(int rev, int txn, SvnDump::File::Node::Action action,
+               SvnDump::File::Node::Kind kind, const std::string& path,
+               int copy_from_rev, const std::string& copy_from_path);
   };
 
 }
@@ -30,10 +30,20 @@
  * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <list>
+#include <deque>
 #include <queue>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <iostream>
 #include <sstream>
@@ -44,7 +54,17 @@
 #include <tr1/tuple>
 #endif
 
+#include <cerrno>
 #include <ctime>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <glob.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <boost/algorithm/string/predicate.hpp>
 #include <boost/bind.hpp>
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "textpool.h"
+
+namespace SvnDump {
+
+namespace {
+  int size_class(std::size_t len)
+  {
+    int         index = 0;
+    std::size_t size  = TextPool::MIN_SIZE;
+    while (size < len) {
+      size <<= 1;
+      ++index;
+    }
+    return index;
+  }
+}
+
+TextPool::~TextPool()
+{
+  for (int i = 0; i < CLASSES; ++i)
+    for (std::vector<char *>::iterator j = free_lists[i].begin();
+         j != free_lists[i].end();
+         ++j)
+      delete[] *j;
+}
+
+/**
+ * Return a buffer of at least `len' bytes, reusing a released one of
+ * the same size class when there is one.
+ */
+TextPool::Buffer TextPool::acquire(std::size_t len)
+{
+  Buffer buffer;
+  if (len > MAX_SIZE) {
+    buffer.data     = new char[len];
+    buffer.capacity = len;
+    return buffer;
+  }
+
+  int index = size_class(len);
+  buffer.capacity = MIN_SIZE << index;
+
+  { std::lock_guard<std::mutex> guard(lock);
+    if (! free_lists[index].empty()) {
+      buffer.data = free_lists[index].back();
+      free_lists[index].pop_back();
+      retained -= buffer.capacity;
+      return buffer;
+    }
+  }
+
+  buffer.data = new char[buffer.capacity];
+  return buffer;
+}
+
+void TextPool::release(Buffer& buffer)
+{
+  if (! buffer.data)
+    return;
+
+  if (buffer.capacity <= MAX_SIZE) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (retained + buffer.capacity <= MAX_RETAINED) {
+      free_lists[size_class(buffer.capacity)].push_back(buffer.data);
+      retained += buffer.capacity;
+      buffer = Buffer();
+      return;
+    }
+  }
+
+  delete[] buffer.data;
+  buffer = Buffer();
+}
+
+} // namespace SvnDump
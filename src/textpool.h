@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _TEXTPOOL_H
+#define _TEXTPOOL_H
+
+#include "system.hpp"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * Recycles the buffers that hold node texts and property blocks, so
+   * that reading a dump does not allocate memory for every node.
+   * Buffers come in power-of-two sizes from MIN_SIZE up to MAX_SIZE;
+   * larger ones are allocated exactly and freed when released.  Up to
+   * MAX_RETAINED bytes of released buffers are kept for reuse.
+   *
+   * Buffers may be released from another thread than the one which
+   * acquired them, as when nodes are handed to the converter.
+   */
+  class TextPool : public noncopyable
+  {
+  public:
+    struct Buffer {
+      char *      data;
+      std::size_t capacity;
+
+      Buffer() : data(nullptr), capacity(0) {}
+    };
+
+    static const std::size_t MIN_SIZE     = 4096;
+    static const std::size_t MAX_SIZE     = 16 * 1024 * 1024;
+    static const std::size_t MAX_RETAINED = 64 * 1024 * 1024;
+
+  private:
+    static const int CLASSES = 13;      // MIN_SIZE << 12 == MAX_SIZE
+
+    std::vector<char *> free_lists[CLASSES];
+    std::size_t         retained;
+    std::mutex          lock;
+
+  public:
+    TextPool() : retained(0) {}
+    ~TextPool();
+
+    Buffer acquire(std::size_t len);
+    void   release(Buffer& buffer);
+  };
+}
+
+#endif // _TEXTPOOL_H
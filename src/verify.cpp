@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "verify.h"
+
+#ifdef HAVE_LIBCRYPTO
+#include <openssl/evp.h>
+#endif
+
+namespace SvnDump {
+
+namespace {
+#ifdef HAVE_LIBCRYPTO
+  std::string digest(const EVP_MD * type, const char * data, std::size_t len)
+  {
+    static const char digits[] = "0123456789abcdef";
+
+    unsigned char id[EVP_MAX_MD_SIZE];
+    unsigned int  id_len = 0;
+    if (! EVP_Digest(data, len, id, &id_len, type, nullptr))
+      throw std::logic_error("Could not compute a checksum");
+
+    std::string hex(id_len * 2, '0');
+    for (unsigned int i = 0; i < id_len; ++i) {
+      hex[i * 2]     = digits[id[i] >> 4];
+      hex[i * 2 + 1] = digits[id[i] & 0xf];
+    }
+    return hex;
+  }
+#endif // HAVE_LIBCRYPTO
+
+  bool has_checksums(const File::Node& node)
+  {
+    return node.has_text() && ! node.is_text_delta() &&
+      (node.has_md5() || node.has_sha1());
+  }
+}
+
+std::string Verifier::Failure::describe() const
+{
+  std::ostringstream buf;
+  buf << "Text of " << pathname.string() << " fails its " << algorithm
+      << " checksum (expected " << expected << ", got " << actual << ")";
+  return buf.str();
+}
+
+Verifier::Verifier(std::size_t threads, std::size_t _max_bytes)
+  : queued_bytes(0), max_bytes(_max_bytes), busy(0), stopping(false),
+    checked(0)
+{
+  if (threads == 0)
+    threads = std::max(1U, std::thread::hardware_concurrency());
+
+  for (std::size_t i = 0; i < threads; ++i)
+    workers.push_back(std::thread(&Verifier::run, this));
+}
+
+Verifier::~Verifier()
+{
+  { std::lock_guard<std::mutex> guard(lock);
+    stopping = true;
+  }
+  not_empty.notify_all();
+
+  for (std::size_t i = 0; i < workers.size(); ++i)
+    workers[i].join();
+}
+
+bool Verifier::available()
+{
+#ifdef HAVE_LIBCRYPTO
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool Verifier::check(const File::Node& node, failures_list& found)
+{
+  if (! has_checksums(node))
+    return false;
+
+#ifdef HAVE_LIBCRYPTO
+  const char * text = node.get_text();
+  std::size_t  len  = node.get_text_length();
+
+  Failure failure;
+  if (node.has_md5()) {
+    std::string actual(digest(EVP_md5(), text, len));
+    if (actual != node.get_text_md5()) {
+      failure.algorithm = "MD5";
+      failure.expected  = node.get_text_md5();
+      failure.actual    = actual;
+    }
+  }
+  if (failure.algorithm.empty() && node.has_sha1()) {
+    std::string actual(digest(EVP_sha1(), text, len));
+    if (actual != node.get_text_sha1()) {
+      failure.algorithm = "SHA1";
+      failure.expected  = node.get_text_sha1();
+      failure.actual    = actual;
+    }
+  }
+  if (! failure.algorithm.empty()) {
+    failure.rev      = node.get_rev_nr();
+    failure.pathname = node.get_path();
+    found.push_back(failure);
+  }
+  return true;
+#else
+  return false;
+#endif // HAVE_LIBCRYPTO
+}
+
+void Verifier::submit(File::Node& node)
+{
+  if (! available() || ! has_checksums(node))
+    return;
+
+  std::size_t len = node.get_text_length();
+
+  std::unique_lock<std::mutex> guard(lock);
+  not_full.wait(guard, [&]() {
+      return queued_bytes == 0 || queued_bytes + len <= max_bytes;
+    });
+
+  queue.push_back(boost::move(node));
+  queued_bytes += len;
+
+  guard.unlock();
+  not_empty.notify_one();
+}
+
+void Verifier::finish()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  idle.wait(guard, [this]() { return queue.empty() && busy == 0; });
+
+  std::sort(failures.begin(), failures.end());
+}
+
+void Verifier::run()
+{
+  for (;;) {
+    std::unique_lock<std::mutex> guard(lock);
+    not_empty.wait(guard, [this]() { return ! queue.empty() || stopping; });
+    if (queue.empty())
+      return;
+
+    File::Node node(boost::move(queue.front()));
+    queue.pop_front();
+    ++busy;
+    guard.unlock();
+
+    failures_list found;
+    std::string   error;
+    try {
+      check(node, found);
+    }
+    catch (const std::exception& err) {
+      error = err.what();
+    }
+    std::size_t len = node.get_text_length();
+
+    // Give the text back to the File before saying we're done with it
+    node.reset();
+
+    guard.lock();
+    queued_bytes -= len;
+    ++checked;
+    failures.insert(failures.end(), found.begin(), found.end());
+    --busy;
+    guard.unlock();
+
+    not_full.notify_all();
+    idle.notify_all();
+  }
+}
+
+} // namespace SvnDump
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2011, BoostPro Computing.  All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * - Neither the name of BoostPro Computing nor the names of its
+ *   contributors may be used to endorse or promote products derived
+ *   from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _VERIFY_H
+#define _VERIFY_H
+
+#include "svndump.h"
+
+using namespace boost;
+
+namespace SvnDump
+{
+  /**
+   * Checks node texts against the MD5 and SHA1 checksums recorded in
+   * the dump, on a pool of worker threads, so that hashing overlaps with
+   * parsing rather than holding it up.  Nodes are moved into the
+   * verifier, which gives back their texts once they are hashed; the
+   * File that read them must outlive the call to finish().
+   *
+   * At most `max_bytes' of text waits to be hashed at any time.  The
+   * checksums of deltified texts are not checked, since the full text
+   * is only known when the converter applies the delta.
+   */
+  class Verifier : public noncopyable
+  {
+  public:
+    struct Failure {
+      int              rev;
+      filesystem::path pathname;
+      std::string      algorithm;
+      std::string      expected;
+      std::string      actual;
+
+      bool operator<(const Failure& other) const {
+        return rev < other.rev ||
+          (rev == other.rev && pathname < other.pathname);
+      }
+
+      std::string describe() const;
+    };
+
+    typedef std::vector<Failure> failures_list;
+
+  private:
+    std::deque<File::Node>   queue;
+    std::size_t              queued_bytes;
+    std::size_t              max_bytes;
+    std::size_t              busy;     // nodes being hashed
+    bool                     stopping;
+    uint64_t                 checked;
+    failures_list            failures;
+
+    std::mutex               lock;
+    std::condition_variable  not_empty;
+    std::condition_variable  not_full;
+    std::condition_variable  idle;
+    std::vector<std::thread> workers;
+
+  public:
+    // A `threads' count of zero uses one thread per processor
+    Verifier(std::size_t threads, std::size_t _max_bytes = 64 << 20);
+    ~Verifier();
+
+    // Whether checksums can be computed at all in this build
+    static bool available();
+
+    // Check one node on the calling thread, adding any mismatches to
+    // `found'.  Returns false if the node had nothing to check.
+    static bool check(const File::Node& node, failures_list& found);
+
+    // Queue `node' to be checked, taking it over if it has a text with
+    // checksums; otherwise it is left as it was.
+    void submit(File::Node& node);
+
+    // Wait until everything queued has been checked.  The mismatches
+    // found are then sorted by revision and path.
+    void finish();
+
+    uint64_t get_checked() const {
+      return checked;
+    }
+    const failures_list& get_failures() const {
+      return failures;
+    }
+
+  private:
+    void run();
+  };
+}
+
+#endif // _VERIFY_H